@@ -10,7 +10,7 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include <JuceHeader.h>
 
 //==============================================================================
 /*
@@ -19,6 +19,8 @@ template<typename Type>
 class Analyser : public Thread
 {
 public:
+    static constexpr int fftOrder = 12;
+
     Analyser() : Thread ("Frequaliser-Analyser")
     {
         averager.clear();
@@ -46,6 +48,43 @@ public:
         waitForData.signal();
     }
 
+    /** Adds audio of a different precision, e.g. from the double processing path. */
+    template<typename OtherType>
+    void addAudioData (const AudioBuffer<OtherType>& buffer, int startChannel, int numChannels)
+    {
+        if (abstractFifo.getFreeSpace() < buffer.getNumSamples())
+            return;
+
+        int start1, block1, start2, block2;
+        abstractFifo.prepareToWrite (buffer.getNumSamples(), start1, block1, start2, block2);
+        auto* fifo = audioFifo.getWritePointer (0);
+
+        for (int i = 0; i < block1 + block2; ++i)
+        {
+            OtherType sum = 0;
+            for (int channel = startChannel; channel < startChannel + numChannels; ++channel)
+                sum += buffer.getSample (channel, i);
+
+            fifo [i < block1 ? start1 + i : start2 + i - block1] = static_cast<Type> (sum);
+        }
+        abstractFifo.finishedWrite (block1 + block2);
+        waitForData.signal();
+    }
+
+    /** Adds the magnitudes of a spectrum that was transformed elsewhere, with the same
+        size and window as the analyser uses. This is safe to call from the audio thread. */
+    void addSpectrum (const float* magnitudes)
+    {
+        if (spectrumFifo.getFreeSpace() < 1)
+            return;
+
+        int start1, block1, start2, block2;
+        spectrumFifo.prepareToWrite (1, start1, block1, start2, block2);
+        spectra.copyFrom (block1 > 0 ? start1 : start2, 0, magnitudes, spectra.getNumSamples());
+        spectrumFifo.finishedWrite (1);
+        waitForData.signal();
+    }
+
     void setupAnalyser (int audioFifoSize, Type sampleRateToUse)
     {
         sampleRate = sampleRateToUse;
@@ -72,13 +111,15 @@ public:
                 windowing.multiplyWithWindowingTable (fftBuffer.getWritePointer (0), size_t (fft.getSize()));
                 fft.performFrequencyOnlyForwardTransform (fftBuffer.getWritePointer (0));
 
-                ScopedLock lockedForWriting (pathCreationLock);
-                averager.addFrom (0, 0, averager.getReadPointer (averagerPtr), averager.getNumSamples(), -1.0f);
-                averager.copyFrom (averagerPtr, 0, fftBuffer.getReadPointer (0), averager.getNumSamples(), 1.0f / (averager.getNumSamples() * (averager.getNumChannels() - 1)));
-                averager.addFrom (0, 0, averager.getReadPointer (averagerPtr), averager.getNumSamples());
-                if (++averagerPtr == averager.getNumChannels()) averagerPtr = 1;
+                addToAverage (fftBuffer.getReadPointer (0));
+            }
 
-                newDataAvailable = true;
+            while (spectrumFifo.getNumReady() > 0)
+            {
+                int start1, block1, start2, block2;
+                spectrumFifo.prepareToRead (1, start1, block1, start2, block2);
+                addToAverage (spectra.getReadPointer (block1 > 0 ? start1 : start2));
+                spectrumFifo.finishedRead (1);
             }
 
             if (abstractFifo.getNumReady() < fft.getSize())
@@ -109,6 +150,17 @@ public:
 
 private:
 
+    void addToAverage (const float* magnitudes)
+    {
+        ScopedLock lockedForWriting (pathCreationLock);
+        averager.addFrom (0, 0, averager.getReadPointer (averagerPtr), averager.getNumSamples(), -1.0f);
+        averager.copyFrom (averagerPtr, 0, magnitudes, averager.getNumSamples(), 1.0f / (averager.getNumSamples() * (averager.getNumChannels() - 1)));
+        averager.addFrom (0, 0, averager.getReadPointer (averagerPtr), averager.getNumSamples());
+        if (++averagerPtr == averager.getNumChannels()) averagerPtr = 1;
+
+        newDataAvailable = true;
+    }
+
     inline float indexToX (float index, float minFreq) const
     {
         const auto freq = (sampleRate * index) / fft.getSize();
@@ -127,7 +179,7 @@ private:
 
     Type sampleRate {};
 
-    dsp::FFT fft                           { 12 };
+    dsp::FFT fft                           { fftOrder };
     dsp::WindowingFunction<Type> windowing { size_t (fft.getSize()), dsp::WindowingFunction<Type>::hann, true };
     AudioBuffer<float> fftBuffer           { 1, fft.getSize() * 2 };
 
@@ -137,6 +189,10 @@ private:
     AbstractFifo abstractFifo              { 48000 };
     AudioBuffer<Type> audioFifo;
 
+    // spectra from the spectral equalizer, which has transformed its frames already
+    AbstractFifo spectrumFifo              { 8 };
+    AudioBuffer<float> spectra             { 8, fft.getSize() / 2 };
+
     std::atomic<bool> newDataAvailable;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Analyser)
@@ -0,0 +1,129 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer coefficient cache
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterDesign.h"
+
+//==============================================================================
+/**
+    Remembers the designs and magnitude responses of the bands for the plots, so
+    recurring parameter values during automation, or the same settings in
+    several instances, don't need to be designed again.
+
+    It is meant to be held in a SharedResourcePointer, so all instances in the
+    process share one. The size is fixed, a new design simply replaces the one
+    in its slot. Each slot is guarded by a spin lock that is only ever tried, so
+    lookups and stores never block: a lookup that finds the slot busy just sees
+    a miss, and a store that finds it busy skips storing.
+
+    The parameters are quantised in the key, and the designs have to be made
+    from the quantised values, so the same key always means the same design.
+*/
+class CoefficientCache
+{
+public:
+    /** The magnitudes are stored for the plot's fixed frequencies. */
+    static constexpr size_t numMagnitudes = 300;
+
+    struct Key
+    {
+        int    type       = -1;
+        int    slope      = 0;
+        bool   matched    = false;
+        int    frequency  = 0;     // cents above 1 Hz
+        int    quality    = 0;     // cents
+        int    gain       = 0;     // 1/100 dB
+        double sampleRate = 0;
+
+        double getFrequency() const   { return std::exp2 (frequency / 1200.0); }
+        double getQuality() const     { return std::exp2 (quality / 1200.0); }
+        double getGain() const        { return Decibels::decibelsToGain (gain / 100.0, -1000.0); }
+
+        bool operator== (const Key& other) const
+        {
+            return type == other.type && slope == other.slope && matched == other.matched
+                && frequency == other.frequency && quality == other.quality && gain == other.gain
+                && sampleRate == other.sampleRate;
+        }
+    };
+
+    struct Entry
+    {
+        FilterDesign::Sections<FilterDesign::Biquad<double>> sections;
+        std::array<double, numMagnitudes>                    magnitudes;
+    };
+
+    CoefficientCache() = default;
+
+    static Key makeKey (int type, int slope, bool matched, double sampleRate, double frequency, double quality, double gain)
+    {
+        Key key;
+        key.type       = type;
+        key.slope      = slope;
+        key.matched    = matched;
+        key.frequency  = roundToInt (1200.0 * std::log2 (jmax (1.0, frequency)));
+        key.quality    = roundToInt (1200.0 * std::log2 (jmax (0.001, quality)));
+        key.gain       = roundToInt (100.0 * Decibels::gainToDecibels (gain, -1000.0));
+        key.sampleRate = sampleRate;
+        return key;
+    }
+
+    /** Copies the entry for the key into result and returns true, if it is cached. */
+    bool lookup (const Key& key, Entry& result) const
+    {
+        auto& slot = slots [getSlotIndex (key)];
+
+        const SpinLock::ScopedTryLockType lock (slot.lock);
+        if (! lock.isLocked() || ! (slot.key == key))
+            return false;
+
+        result = slot.entry;
+        return true;
+    }
+
+    /** Stores the entry, unless another thread is using the same slot. */
+    void store (const Key& key, const Entry& entry)
+    {
+        auto& slot = slots [getSlotIndex (key)];
+
+        const SpinLock::ScopedTryLockType lock (slot.lock);
+        if (! lock.isLocked())
+            return;
+
+        slot.key   = key;
+        slot.entry = entry;
+    }
+
+private:
+    static size_t getSlotIndex (const Key& key)
+    {
+        auto hash = uint64 (std::hash<double>() (key.sampleRate));
+        for (auto value : { key.type, key.slope, int (key.matched), key.frequency, key.quality, key.gain })
+            hash = (hash ^ uint64 (uint32 (value))) * 1099511628211ull;
+
+        // the multiplications only carry upwards, so mix the high bits into the low ones
+        hash = (hash ^ (hash >> 31)) * 0x94d049bb133111ebull;
+        return size_t ((hash ^ (hash >> 32)) % numSlots);
+    }
+
+    static constexpr size_t numSlots = 256;
+
+    struct Slot
+    {
+        SpinLock lock;
+        Key      key;
+        Entry    entry;
+    };
+
+    // the lookups lock as well, they only read
+    mutable std::array<Slot, numSlots> slots;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CoefficientCache)
+};
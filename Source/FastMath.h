@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer fast math for the coefficient design
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Polynomial approximations of the functions the filter designs need.
+
+    They are branch free, so the batch versions vectorise, and accurate enough to
+    design double precision coefficients:
+
+    - sinCos has an absolute error below 1e-13, tan a relative error below 1e-11
+    - exp2 has a relative error below 1e-13, arguments are limited to +-1022
+
+    gcc only vectorises the selects with -fno-trapping-math, which the jucers pass
+    to Xcode and the Linux Makefile. Visual Studio has no such switch and may keep
+    them scalar.
+
+    FilterDesign::AccuracyTest checks them against the standard library.
+*/
+namespace FastMath
+{
+
+/** sin and cos for |x| <= pi / 4 as Taylor polynomials, the remainders are below 1e-13 */
+inline void sinCosQuarter (double x, double& sine, double& cosine)
+{
+    const auto x2 = x * x;
+    sine   = x * (1.0 + x2 * (-1.0 / 6.0 + x2 * (1.0 / 120.0 + x2 * (-1.0 / 5040.0 + x2 * (1.0 / 362880.0
+                  + x2 * (-1.0 / 39916800.0 + x2 * (1.0 / 6227020800.0)))))));
+    cosine = 1.0 + x2 * (-0.5 + x2 * (1.0 / 24.0 + x2 * (-1.0 / 720.0 + x2 * (1.0 / 40320.0 + x2 * (-1.0 / 3628800.0
+                  + x2 * (1.0 / 479001600.0 + x2 * (-1.0 / 87178291200.0)))))));
+}
+
+/** sin and cos for |x| <= pi */
+inline void sinCos (double x, double& sine, double& cosine)
+{
+    // the half angle is folded into the first octant, then doubled again
+    const auto half     = 0.5 * std::abs (x);
+    const auto mirrored = half > 0.25 * MathConstants<double>::pi;
+    const auto reduced  = mirrored ? 0.5 * MathConstants<double>::pi - half : half;
+
+    double s, c;
+    sinCosQuarter (reduced, s, c);
+
+    const auto sineHalf   = mirrored ? c : s;
+    const auto cosineHalf = mirrored ? s : c;
+
+    sine   = std::copysign (2.0 * sineHalf * cosineHalf, x);
+    cosine = (cosineHalf - sineHalf) * (cosineHalf + sineHalf);
+}
+
+/** tan for |x| < pi / 2 */
+inline double tan (double x)
+{
+    const auto absolute = std::abs (x);
+    const auto mirrored = absolute > 0.25 * MathConstants<double>::pi;
+    const auto reduced  = mirrored ? 0.5 * MathConstants<double>::pi - absolute : absolute;
+
+    double s, c;
+    sinCosQuarter (reduced, s, c);
+
+    const auto numerator   = mirrored ? c : s;
+    const auto denominator = mirrored ? s : c;
+    return std::copysign (numerator / denominator, x);
+}
+
+/** 2 to the power of x */
+inline double exp2 (double x)
+{
+    // jlimit would keep the batch version from vectorising
+    x = x < -1022.0 ? -1022.0 : (x > 1022.0 ? 1022.0 : x);
+
+    // adding 1.5 * 2^52 rounds x to the nearest integer n, which ends up in the low bits
+    const auto shifted = x + 6755399441055744.0;
+    const auto n       = shifted - 6755399441055744.0;
+
+    // 2^x = 2^n * e^(f * ln 2) with |f| <= 0.5, the Taylor remainder is below 1e-13
+    const auto f = (x - n) * 0.69314718055994530942;
+    const auto p = 1.0 + f * (1.0 + f * (1.0 / 2.0 + f * (1.0 / 6.0 + f * (1.0 / 24.0 + f * (1.0 / 120.0 + f * (1.0 / 720.0
+                       + f * (1.0 / 5040.0 + f * (1.0 / 40320.0 + f * (1.0 / 362880.0 + f * (1.0 / 3628800.0 + f * (1.0 / 39916800.0)))))))))));
+
+    // n goes straight into the exponent bits, the rest of the shifted value is shifted out
+    uint64 bits;
+    std::memcpy (&bits, &shifted, sizeof (bits));
+    bits = (bits + 1023) << 52;
+
+    double scale;
+    std::memcpy (&scale, &bits, sizeof (scale));
+    return p * scale;
+}
+
+inline double decibelsToGain (double decibels)
+{
+    // log2 (10) / 20
+    return exp2 (decibels * 0.16609640474436811739);
+}
+
+//==============================================================================
+// batch versions, input and output may be the same array
+
+inline void sinCos (const double* x, double* sines, double* cosines, size_t num)
+{
+    for (size_t i = 0; i < num; ++i)
+        sinCos (x [i], sines [i], cosines [i]);
+}
+
+inline void tan (const double* x, double* result, size_t num)
+{
+    for (size_t i = 0; i < num; ++i)
+        result [i] = tan (x [i]);
+}
+
+inline void exp2 (const double* x, double* result, size_t num)
+{
+    for (size_t i = 0; i < num; ++i)
+        result [i] = exp2 (x [i]);
+}
+
+} // namespace FastMath
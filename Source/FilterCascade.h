@@ -0,0 +1,1053 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer filter cascade
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterDesign.h"
+
+//==============================================================================
+/** The section structures a FilterCascade can run. */
+namespace FilterTopology
+{
+    /** Biquad sections in transposed direct form II. */
+    struct TransposedDirectForm2
+    {
+        template<typename Type>
+        using Section = FilterDesign::Biquad<Type>;
+
+        // b0, b1, b2, a1, a2
+        static constexpr size_t numCoefficients = 5;
+
+        // an identity section still outputs its state, so it has to run out first
+        static constexpr bool identityUsesState = true;
+
+        template<typename Type>
+        static void getCoefficients (const Section<Type>& c, Type* values)
+        {
+            values [0] = c.b0; values [1] = c.b1; values [2] = c.b2; values [3] = c.a1; values [4] = c.a2;
+        }
+
+        /** Scales the output of a section by scaling its numerator. */
+        template<typename Type>
+        static void scaleOutput (Type* values, Type gain)
+        {
+            values [0] *= gain; values [1] *= gain; values [2] *= gain;
+        }
+
+        template<typename SIMDType>
+        static SIMDType processSample (SIMDType x, SIMDType* const* c, size_t s, SIMDType& s1, SIMDType& s2)
+        {
+            const auto y = c[0][s] * x + s1;
+            s1 = c[1][s] * x - c[3][s] * y + s2;
+            s2 = c[2][s] * x - c[4][s] * y;
+            return y;
+        }
+
+        /** The next two outputs of a section without input, which is all its state holds. */
+        static void getStateResponse (const double* c, double s1, double s2, double& y0, double& y1)
+        {
+            y0 = s1;
+            y1 = s2 - c[3] * s1;
+        }
+
+        /** The state that outputs y0 and y1 next without input. */
+        static void setStateResponse (const double* c, double y0, double y1, double& s1, double& s2)
+        {
+            s1 = y0;
+            s2 = y1 + c[3] * y0;
+        }
+    };
+
+    /** Trapezoidal state variable filter sections, see FilterDesign::Svf. */
+    struct StateVariable
+    {
+        template<typename Type>
+        using Section = FilterDesign::Svf<Type>;
+
+        // a1, a2, a3, m0, m1, m2
+        static constexpr size_t numCoefficients = 6;
+
+        // identity only holds the integrators, so a section can go as soon as it got there
+        static constexpr bool identityUsesState = false;
+
+        template<typename Type>
+        static void getCoefficients (const Section<Type>& c, Type* values)
+        {
+            values [0] = c.a1; values [1] = c.a2; values [2] = c.a3; values [3] = c.m0; values [4] = c.m1; values [5] = c.m2;
+        }
+
+        /** Scales the output of a section by scaling its mix coefficients. */
+        template<typename Type>
+        static void scaleOutput (Type* values, Type gain)
+        {
+            values [3] *= gain; values [4] *= gain; values [5] *= gain;
+        }
+
+        template<typename SIMDType>
+        static SIMDType processSample (SIMDType x, SIMDType* const* c, size_t s, SIMDType& ic1, SIMDType& ic2)
+        {
+            const auto v3 = x - ic2;
+            const auto v1 = c[0][s] * ic1 + c[1][s] * v3;
+            const auto v2 = ic2 + c[1][s] * ic1 + c[2][s] * v3;
+            ic1 = v1 + v1 - ic1;
+            ic2 = v2 + v2 - ic2;
+            return c[3][s] * x + c[4][s] * v1 + c[5][s] * v2;
+        }
+
+        /** The next two outputs of a section without input, see processSample(). */
+        static void getStateResponse (const double* c, double ic1, double ic2, double& y0, double& y1)
+        {
+            double o [4];
+            getObservability (c, o);
+            y0 = o[0] * ic1 + o[1] * ic2;
+            y1 = o[2] * ic1 + o[3] * ic2;
+        }
+
+        /** The state that outputs y0 and y1 next without input. The mix hides a direction of
+            the state at identity, in first order sections, or where a zero cancels a pole, so the
+            solution is damped a little to leave that direction at rest. The damping is tiny, as
+            the two outputs of a slow section at a high sample rate hardly differ, and both are
+            needed to tell its integrators apart. */
+        static void setStateResponse (const double* c, double y0, double y1, double& ic1, double& ic2)
+        {
+            double o [4];
+            getObservability (c, o);
+
+            // least squares with damping, (O^T O + damping) ic = O^T y
+            const auto norm    = o[0] * o[0] + o[1] * o[1] + o[2] * o[2] + o[3] * o[3];
+            const auto damping = 1.0e-16 * norm;
+            const auto m00 = o[0] * o[0] + o[2] * o[2] + damping;
+            const auto m01 = o[0] * o[1] + o[2] * o[3];
+            const auto m11 = o[1] * o[1] + o[3] * o[3] + damping;
+            const auto r0  = o[0] * y0 + o[2] * y1;
+            const auto r1  = o[1] * y0 + o[3] * y1;
+            const auto det = m00 * m11 - m01 * m01;
+
+            ic1 = ic2 = 0;
+            if (! (det > 0))
+                return;
+
+            ic1 = (m11 * r0 - m01 * r1) / det;
+            ic2 = (m00 * r1 - m01 * r0) / det;
+        }
+
+        /** The outputs without input over two samples as a matrix of the two states, by rows. */
+        static void getObservability (const double* c, double* o)
+        {
+            const auto a1 = c[0], a2 = c[1], a3 = c[2], m1 = c[4], m2 = c[5];
+            o[0] = m1 * a1 + m2 * a2;
+            o[1] = m2 * (1.0 - a3) - m1 * a2;
+            o[2] = o[0] * (2.0 * a1 - 1.0) + o[1] * 2.0 * a2;
+            o[3] = o[1] * (1.0 - 2.0 * a3) - o[0] * 2.0 * a2;
+        }
+    };
+}
+
+//==============================================================================
+/** The channels a section filters. Left and Right are the even and odd channel of
+    each pair, Mid and Side are their sum and difference. */
+enum class ChannelRouting
+{
+    Stereo = 0,
+    Left,
+    Right,
+    Mid,
+    Side
+};
+
+//==============================================================================
+/**
+    Runs a cascade of filter sections and the output gain in a single pass
+    over the buffer.
+
+    Each SIMD lane carries one channel, so every section filters a whole group
+    of channels with one vector instruction stream. Up to maxGroupsPerPass
+    groups run side by side, which makes a pass as wide as 16 float channels
+    with SSE. Each sample is pushed through all active sections before the
+    next sample is read, so the buffer is only touched once per block.
+
+    The output gain is folded into the numerator of the last section that does
+    any filtering, so it costs nothing per sample. Only while no section
+    filters, the gain is applied on its own, and not at all when it is unity.
+    When another section takes the gain, it is handed over within fadeSeconds
+    so that the product of both sections' shares stays the gain.
+
+    The coefficients are owned by the audio thread. They can either be set
+    immediately, or ramped linearly to a new target over the next block, which
+    allows to design them at a control rate and interpolate in between. A ramp
+    can also be longer than the block and go on in the next ones, so a control
+    step that spans two host blocks still ramps over its full length.
+
+    Bypassing a section crossfades it to its input over a few milliseconds,
+    while it keeps filtering. A section that comes back starts from rest and is
+    faded in. Once a section is bypassed, or identity with its state run out,
+    it is dropped from the cascade, so unused bands cost nothing until they
+    are needed again.
+
+    The coefficients and state are kept in SampleType, while the buffers are
+    in IOType. This allows to filter float buffers with double precision, which
+    low frequencies at high sample rates need.
+
+    Each section can be routed to some of the channels, see ChannelRouting.
+    The coefficients are held per lane, the lanes a section isn't routed to
+    are identity, so a section costs the same whatever it is routed to. The
+    sections on left and right run first, then each pair of lanes is turned
+    into mid and side for the rest and back at the end, within the same pass.
+    A running section changes its routing like a bypass, it fades out, moves
+    to the new channels and fades in again from rest.
+
+    The Topology selects the structure of the sections, see FilterTopology.
+*/
+template<typename SampleType, typename IOType = SampleType, typename Topology = FilterTopology::TransposedDirectForm2>
+class FilterCascade
+{
+public:
+    using NumericType = SampleType;
+    using SIMDType    = dsp::SIMDRegister<SampleType>;
+
+    using Section     = typename Topology::template Section<SampleType>;
+
+    FilterCascade() = default;
+
+    /** Sets the number of sections. Must not be called while processing. */
+    void setNumSections (size_t numSectionsToUse)
+    {
+        numSections = numSectionsToUse;
+
+        // each coefficient is stored contiguously for all sections, once for the current
+        // values, the ramp targets, the per sample increments and where the ramp started
+        auto* data = allocateAligned<SIMDType> (coefficientData, 4 * numCoefficients * numSections);
+        for (size_t k = 0; k < numCoefficients; ++k)
+        {
+            coefficients [k] = data + k * numSections;
+            targets [k]      = data + (k + numCoefficients) * numSections;
+            increments [k]   = data + (k + 2 * numCoefficients) * numSections;
+            rampStarts [k]   = data + (k + 3 * numCoefficients) * numSections;
+        }
+
+        designs.resize (numSections);
+        pending.assign (numSections, false);
+        bypassed.assign (numSections, false);
+        wasBypassed.assign (numSections, false);
+        ramping.assign (numSections, false);
+        fading.assign (numSections, false);
+        wetLevels.assign (numSections, SampleType (1));
+        routings.assign (numSections, ChannelRouting::Stereo);
+        nextRoutings.assign (numSections, ChannelRouting::Stereo);
+        running.assign (numSections, false);
+        active.resize (numSections);
+
+        // the wet level of each section, its per sample increment while fading and where it started
+        mixes          = allocateAligned<SIMDType> (mixData, 3 * numSections);
+        mixIncrements  = mixes + numSections;
+        mixStarts      = mixes + 2 * numSections;
+
+        gainSection         = numSections;
+        previousGainSection = numSections;
+        handingOver         = false;
+        for (size_t i = 0; i < numSections; ++i)
+            setCoefficients (i, Section());
+    }
+
+    size_t getNumSections() const
+    {
+        return numSections;
+    }
+
+    /** The channels the state is kept for, which is a whole number of SIMD registers. */
+    size_t getNumLanes() const
+    {
+        return numGroups * SIMDType::size();
+    }
+
+    void prepare (const dsp::ProcessSpec& spec)
+    {
+        numGroups = (spec.numChannels + SIMDType::size() - 1) / SIMDType::size();
+        state = allocateAligned<SIMDType> (stateData, 2 * numSections * numGroups);
+        fadeStep  = SampleType (1.0 / (fadeSeconds * spec.sampleRate));
+        reset();
+    }
+
+    void reset()
+    {
+        for (size_t i = 0; i < 2 * numSections * numGroups; ++i)
+            state [i] = SIMDType::expand (0);
+
+        for (size_t i = 0; i < numSections; ++i)
+        {
+            if (routings [i] != nextRoutings [i] || ramping [i])
+            {
+                routings [i] = nextRoutings [i];
+                retarget (i, 0);
+                ramping [i] = false;
+            }
+
+            wasBypassed [i] = bypassed [i];
+            fading [i]      = false;
+            setWetLevel (i, bypassed [i] ? 0 : 1);
+            running [i]     = isFiltering (i);
+        }
+
+        rampSamplesLeft = 0;
+        updateGainSection (0, 0);
+    }
+
+    /** Takes over the state of another cascade with the same sections, in any precision and
+        topology, so a switch goes on filtering instead of starting from rest. The state is
+        handed over as the output it would give without input, which is exact when both run
+        the same designs. Call this after setting the coefficients, only from the audio thread. */
+    template<typename OtherCascade>
+    void copyStateFrom (const OtherCascade& other)
+    {
+        jassert (other.getNumSections() == numSections);
+        const auto numLanes = jmin (getNumLanes(), other.getNumLanes());
+
+        for (size_t s = 0; s < numSections; ++s)
+        {
+            if (! running [s])
+                continue;
+
+            for (size_t lane = 0; lane < numLanes; ++lane)
+            {
+                double y0, y1;
+                other.getStateResponse (s, lane, y0, y1);
+                setStateResponse (s, lane, y0, y1);
+            }
+        }
+    }
+
+    /** The next two outputs of a section on one channel, if its input stayed silent. */
+    void getStateResponse (size_t section, size_t lane, double& y0, double& y1) const
+    {
+        double c [numCoefficients];
+        getLaneCoefficients (section, lane, c);
+
+        const auto* s1 = state + 2 * numSections * (lane / SIMDType::size());
+        const auto  l  = lane % SIMDType::size();
+        Topology::getStateResponse (c, double (s1 [section].get (l)), double (s1 [section + numSections].get (l)), y0, y1);
+    }
+
+    /** Sets the state of a section on one channel, so that without input it outputs y0 and y1 next. */
+    void setStateResponse (size_t section, size_t lane, double y0, double y1)
+    {
+        double c [numCoefficients];
+        getLaneCoefficients (section, lane, c);
+
+        double v1, v2;
+        Topology::setStateResponse (c, y0, y1, v1, v2);
+
+        auto* s1 = state + 2 * numSections * (lane / SIMDType::size());
+        const auto l = lane % SIMDType::size();
+        s1 [section].set (l, SampleType (v1));
+        s1 [section + numSections].set (l, SampleType (v2));
+    }
+
+    /** Sets the coefficients of a section immediately. Only call this from the audio thread
+        or while not processing. */
+    void setCoefficients (size_t section, const Section& newCoefficients)
+    {
+        jassert (section < numSections);
+        designs [section]     = newCoefficients;
+        routings [section]    = nextRoutings [section];
+        pending [section]     = false;
+        wasBypassed [section] = bypassed [section];
+        ramping [section]     = false;
+        fading [section]      = false;
+        setWetLevel (section, bypassed [section] ? 0 : 1);
+        running [section]     = running [section] || isFiltering (section);
+
+        retarget (section, 0);
+        updateGainSection (0, 0);
+    }
+
+    /** Ramps the coefficients of a section linearly to the target during the next ramp of
+        process(). Only call this from the audio thread. */
+    void setTargetCoefficients (size_t section, const Section& target)
+    {
+        jassert (section < numSections);
+        designs [section] = target;
+        pending [section] = true;
+    }
+
+    /** A bypassed section is faded out from the next call to process() on, and faded in
+        again from rest when it returns. Only call this from the audio thread or while not
+        processing. */
+    void setBypassed (size_t section, bool shouldBeBypassed)
+    {
+        jassert (section < numSections);
+        bypassed [section] = shouldBeBypassed;
+    }
+
+    /** Routes a section to some of the channels. A running section is faded out from the
+        next call to process() on, then moved and faded in again from rest, as its state
+        means nothing on other channels. Only call this from the audio thread or while not
+        processing. */
+    void setRouting (size_t section, ChannelRouting routing)
+    {
+        jassert (section < numSections);
+        nextRoutings [section] = routing;
+    }
+
+    /** Returns the number of sections that were processed in the last block. */
+    size_t getNumActiveSections() const
+    {
+        return numActive;
+    }
+
+    /** Sets the output gain immediately. Only call this from the audio thread or while
+        not processing. */
+    void setGainLinear (SampleType newGain)
+    {
+        gain = targetGain = newGain;
+        retarget (gainSection, 0);
+        updateGainSection (0, 0);
+    }
+
+    /** Ramps the output gain linearly to the target during the next ramp of process().
+        Only call this from the audio thread. */
+    void setTargetGainLinear (SampleType newGain)
+    {
+        targetGain = newGain;
+    }
+
+    SampleType getGainLinear() const
+    {
+        return targetGain;
+    }
+
+    void process (const dsp::ProcessContextReplacing<IOType>& context)
+    {
+        process (context, context.getOutputBlock().getNumSamples());
+    }
+
+    /** Processes the block, and reaches new targets after numRampSamples, which may be more
+        than the block. The ramp then goes on in the next calls, which don't start new ramps
+        until it is done. Any targets set in between join it and end with it. */
+    void process (const dsp::ProcessContextReplacing<IOType>& context, size_t numRampSamples)
+    {
+        auto& block = context.getOutputBlock();
+        const auto numChannels = block.getNumChannels();
+        const auto numSamples  = block.getNumSamples();
+        const auto numLanes    = SIMDType::size();
+        jassert ((numChannels + numLanes - 1) / numLanes <= numGroups);
+
+        if (numSamples == 0)
+            return;
+
+        // a ramp in progress sets where this one ends, it only ends earlier if the block is longer
+        const auto continuing = rampSamplesLeft > 0;
+        auto rampLength = continuing ? rampSamplesLeft : jmax (numSamples, numRampSamples);
+        if (rampLength < numSamples)
+        {
+            const auto scale = SIMDType::expand (SampleType (rampLength) / SampleType (numSamples));
+            for (size_t i = 0; i < numSections; ++i)
+                if (ramping [i])
+                    for (size_t k = 0; k < numCoefficients; ++k)
+                        increments [k][i] = increments [k][i] * scale;
+
+            rampLength = numSamples;
+        }
+
+        for (size_t i = 0; i < numSections; ++i)
+        {
+            if (routings [i] != nextRoutings [i])
+            {
+                // a section that doesn't run can move right away
+                if (running [i])
+                {
+                    fading [i] = true;
+                }
+                else
+                {
+                    routings [i] = nextRoutings [i];
+                    retarget (i, 0);
+                }
+            }
+
+            if (pending [i])
+            {
+                // a section that doesn't run can take the new coefficients right away
+                pending [i] = false;
+                running [i] = running [i] || isFiltering (i);
+                retarget (i, running [i] ? rampLength : 0);
+            }
+
+            if (bypassed [i] != wasBypassed [i])
+            {
+                wasBypassed [i] = bypassed [i];
+                if (! running [i] && ! isFiltering (i))
+                {
+                    setWetLevel (i, bypassed [i] ? 0 : 1);
+                }
+                else
+                {
+                    if (! running [i])
+                    {
+                        clearState (i);
+                        setWetLevel (i, 0);
+                    }
+
+                    running [i] = true;
+                    fading [i]  = true;
+                }
+            }
+        }
+
+        // the sections on left and right come first, the ones on mid and side follow
+        numActive = 0;
+        for (size_t i = 0; i < numSections; ++i)
+            if (running [i] && ! isMidSide (routings [i]))
+                active [numActive++] = i;
+
+        numLeftRight = numActive;
+        for (size_t i = 0; i < numSections; ++i)
+            if (running [i] && isMidSide (routings [i]))
+                active [numActive++] = i;
+
+        // the fades are linear over fadeSeconds, split into one ramp per block
+        for (size_t i = 0; i < numActive; ++i)
+        {
+            const auto s = active [i];
+            if (fading [s])
+            {
+                // a section hands the gain over before it fades out, the fade would take it along
+                if (isFadingOut (s) && carriesGain (s))
+                {
+                    mixIncrements [s] = SIMDType::expand (0);
+                    continue;
+                }
+
+                const auto distance = fadeStep * SampleType (numSamples);
+                const auto end      = isFadingOut (s) ? jmax (SampleType (0), wetLevels [s] - distance)
+                                                      : jmin (SampleType (1), wetLevels [s] + distance);
+                mixIncrements [s] = SIMDType::expand ((end - wetLevels [s]) / SampleType (numSamples));
+                wetLevels [s]     = end;
+            }
+        }
+
+        // a new gain ramps in the section that carries it, then moves along if the cascade changed
+        if (targetGain != gain)
+        {
+            gain = targetGain;
+            retarget (gainSection, rampLength);
+        }
+
+        // a handover advances once per ramp, when it starts
+        updateGainSection (rampLength, continuing ? 0 : rampLength);
+        rampSamplesLeft = rampLength - numSamples;
+
+        const bool anyRamping      = std::any_of (active.begin(), active.begin() + std::ptrdiff_t (numActive),
+                                                  [this] (size_t s) { return ramping [s] || fading [s]; });
+        const bool applyOutputGain = outputGain != SampleType (1) || outputIncrement != SampleType (0);
+
+        if (numActive == 0 && ! applyOutputGain)
+            return;
+
+        if (applyOutputGain)
+        {
+            if (anyRamping)
+                processSections<true, true> (block);
+            else
+                processSections<false, true> (block);
+
+            if (rampSamplesLeft > 0)
+            {
+                outputGain += outputIncrement * SampleType (numSamples);
+            }
+            else
+            {
+                outputGain      = outputTarget;
+                outputIncrement = 0;
+            }
+        }
+        else
+        {
+            if (anyRamping)
+                processSections<true, false> (block);
+            else
+                processSections<false, false> (block);
+        }
+
+        for (size_t i = 0; i < numActive; ++i)
+        {
+            const auto s = active [i];
+            if (ramping [s] && rampSamplesLeft == 0)
+            {
+                // land exactly on the targets, whatever rounding happened on the way
+                for (size_t k = 0; k < numCoefficients; ++k)
+                {
+                    coefficients [k][s] = targets [k][s];
+                    increments [k][s]   = SIMDType::expand (0);
+                }
+
+                ramping [s] = false;
+            }
+
+            if (fading [s])
+            {
+                setWetLevel (s, wetLevels [s]);
+                if (! bypassed [s] && routings [s] != nextRoutings [s] && wetLevels [s] == 0)
+                {
+                    // silent now, so it moves to the new channels and fades in from rest
+                    routings [s] = nextRoutings [s];
+                    retarget (s, 0);
+                    clearState (s);
+                }
+                else if (wetLevels [s] == (bypassed [s] ? 0 : 1))
+                {
+                    fading [s] = false;
+
+                    // the output is the input now, whatever the state is
+                    if (bypassed [s])
+                    {
+                        clearState (s);
+                        running [s] = false;
+                    }
+                }
+            }
+            else if (! ramping [s] && FilterDesign::isIdentity (designs [s]) && ! carriesGain (s) && (! Topology::identityUsesState || isSilent (s)))
+            {
+                // a biquad at identity flushes its state within two samples, after that it can go.
+                // Clearing the state lets a section that comes back start from rest.
+                clearState (s);
+                running [s] = false;
+            }
+        }
+    }
+
+private:
+    void getLaneCoefficients (size_t section, size_t lane, double* c) const
+    {
+        for (size_t k = 0; k < numCoefficients; ++k)
+            c [k] = double (coefficients [k][section].get (lane % SIMDType::size()));
+    }
+
+    static bool isMidSide (ChannelRouting routing)
+    {
+        return routing == ChannelRouting::Mid || routing == ChannelRouting::Side;
+    }
+
+    /** Even lanes carry left or mid, odd lanes right or side. */
+    static bool isRoutedTo (ChannelRouting routing, size_t lane)
+    {
+        switch (routing)
+        {
+            case ChannelRouting::Left:
+            case ChannelRouting::Mid:    return (lane & 1) == 0;
+            case ChannelRouting::Right:
+            case ChannelRouting::Side:   return (lane & 1) != 0;
+            case ChannelRouting::Stereo:
+            default:                     return true;
+        }
+    }
+
+    static SIMDType toMidSide (SIMDType x)
+    {
+        alignas (SIMDType) SampleType lanes [SIMDType::SIMDNumElements];
+        x.copyToRawArray (lanes);
+        for (size_t lane = 0; lane + 1 < SIMDType::SIMDNumElements; lane += 2)
+        {
+            const auto left  = lanes [lane];
+            const auto right = lanes [lane + 1];
+            lanes [lane]     = SampleType (0.5) * (left + right);
+            lanes [lane + 1] = SampleType (0.5) * (left - right);
+        }
+        return SIMDType::fromRawArray (lanes);
+    }
+
+    static SIMDType toLeftRight (SIMDType x)
+    {
+        alignas (SIMDType) SampleType lanes [SIMDType::SIMDNumElements];
+        x.copyToRawArray (lanes);
+        for (size_t lane = 0; lane + 1 < SIMDType::SIMDNumElements; lane += 2)
+        {
+            const auto mid  = lanes [lane];
+            const auto side = lanes [lane + 1];
+            lanes [lane]     = mid + side;
+            lanes [lane + 1] = mid - side;
+        }
+        return SIMDType::fromRawArray (lanes);
+    }
+
+    /** A section fades out to be bypassed, or to move to other channels. */
+    bool isFadingOut (size_t section) const
+    {
+        return bypassed [section] || routings [section] != nextRoutings [section];
+    }
+
+    bool isFiltering (size_t section) const
+    {
+        return ! bypassed [section] && ! FilterDesign::isIdentity (designs [section]);
+    }
+
+    void setWetLevel (size_t section, SampleType level)
+    {
+        wetLevels [section]     = level;
+        mixes [section]         = SIMDType::expand (level);
+        mixIncrements [section] = SIMDType::expand (0);
+    }
+
+    /** Sets the coefficients of a section to its target, including the output gain if it
+        carries it. With numRampSamples > 0 they are ramped to it during the next block. */
+    void retarget (size_t section, size_t numRampSamples)
+    {
+        if (section >= numSections)
+            return;
+
+        SampleType values [numCoefficients], identity [numCoefficients];
+        Topology::getCoefficients (designs [section], values);
+        Topology::getCoefficients (Section(), identity);
+        const auto share = getGainShare (section);
+        if (share != SampleType (1))
+            Topology::scaleOutput (values, share);
+
+        // the lanes the section isn't routed to pass their signal unchanged
+        alignas (SIMDType) SampleType lanes [numCoefficients][SIMDType::SIMDNumElements];
+        for (size_t lane = 0; lane < SIMDType::SIMDNumElements; ++lane)
+        {
+            const auto* source = isRoutedTo (routings [section], lane) ? values : identity;
+            for (size_t k = 0; k < numCoefficients; ++k)
+                lanes [k][lane] = source [k];
+        }
+
+        if (numRampSamples > 0)
+        {
+            const auto scale = SIMDType::expand (SampleType (1) / SampleType (numRampSamples));
+            for (size_t k = 0; k < numCoefficients; ++k)
+            {
+                targets [k][section]    = SIMDType::fromRawArray (lanes [k]);
+                increments [k][section] = (targets [k][section] - coefficients [k][section]) * scale;
+            }
+
+            ramping [section] = true;
+        }
+        else
+        {
+            for (size_t k = 0; k < numCoefficients; ++k)
+            {
+                coefficients [k][section] = SIMDType::fromRawArray (lanes [k]);
+                targets [k][section]      = coefficients [k][section];
+                increments [k][section]   = SIMDType::expand (0);
+            }
+        }
+    }
+
+    /** Moves the output gain to the last running section that filters all channels at its
+        full level, or to the separate gain stage if there is none. A fading section can't take
+        it, its gain would fade with it, and identity sections have to stay identity to be
+        dropped. The gain is handed over within fadeSeconds, it advances by numElapsedSamples
+        and ramps to there within numRampSamples, see getGainShare(). */
+    void updateGainSection (size_t numRampSamples, size_t numElapsedSamples)
+    {
+        auto section = numSections;
+        for (auto i = numSections; i > 0; --i)
+        {
+            if (running [i - 1] && ! fading [i - 1] && isFiltering (i - 1) && routings [i - 1] == ChannelRouting::Stereo)
+            {
+                section = i - 1;
+                break;
+            }
+        }
+
+        if (section != gainSection)
+        {
+            const auto wasHandingOver = handingOver;
+            const auto older          = previousGainSection;
+
+            // going back to the section it came from retraces the same path
+            handover            = wasHandingOver && section == older ? SampleType (1) - handover : SampleType (0);
+            previousGainSection = gainSection;
+            gainSection         = section;
+            handingOver         = true;
+
+            // a third section interrupts the handover, the one before lets go within this block
+            if (wasHandingOver && older != section)
+                retarget (older, numRampSamples);
+        }
+
+        if (handingOver)
+        {
+            // a block ends at the middle, so that only one of the two moves at a time
+            const auto end = handover < SampleType (0.5) ? SampleType (0.5) : SampleType (1);
+            handover    = numRampSamples > 0 ? jmin (end, handover + fadeStep * SampleType (numElapsedSamples)) : SampleType (1);
+            handingOver = handover < SampleType (1);
+
+            retarget (previousGainSection, numRampSamples);
+            retarget (gainSection, numRampSamples);
+        }
+
+        outputTarget = getGainShare (numSections);
+        if (numRampSamples > 0)
+        {
+            outputIncrement = (outputTarget - outputGain) / SampleType (numRampSamples);
+        }
+        else
+        {
+            outputGain      = outputTarget;
+            outputIncrement = 0;
+        }
+    }
+
+    bool carriesGain (size_t section) const
+    {
+        return section == gainSection || (handingOver && section == previousGainSection);
+    }
+
+    /** The part of the output gain a section scales its output with, numSections is the
+        separate gain stage. During a handover the new section first moves linearly to the
+        square root of the gain, then the previous one moves linearly to unity, and the other
+        one carries the rest. The product stays the gain at every block boundary, and a gain
+        of zero stays zero throughout, as one of the two is zero at any time. */
+    SampleType getGainShare (size_t section) const
+    {
+        if (! carriesGain (section))
+            return 1;
+
+        if (! handingOver)
+            return gain;
+
+        const auto root      = std::sqrt (jmax (SampleType (0), gain));
+        const auto firstHalf = handover < SampleType (0.5);
+        const auto moving    = firstHalf ? SampleType (1) + (root - SampleType (1)) * SampleType (2) * handover
+                                         : root + (SampleType (1) - root) * (SampleType (2) * handover - SampleType (1));
+        const auto rest      = moving > SampleType (0) ? gain / moving : root;
+
+        return (section == gainSection) == firstHalf ? moving : rest;
+    }
+
+    bool isSilent (size_t section) const
+    {
+        for (size_t group = 0; group < numGroups; ++group)
+        {
+            const auto* s1 = state + 2 * numSections * group;
+            const auto* s2 = s1 + numSections;
+            if (! s1 [section].allValuesEqualTo (0) || ! s2 [section].allValuesEqualTo (0))
+                return false;
+        }
+        return true;
+    }
+
+    void clearState (size_t section)
+    {
+        for (size_t group = 0; group < numGroups; ++group)
+        {
+            auto* s1 = state + 2 * numSections * group;
+            s1 [section] = SIMDType::expand (0);
+            s1 [section + numSections] = SIMDType::expand (0);
+        }
+    }
+
+    /** Filters the channels in passes of up to maxGroupsPerPass registers. */
+    template<bool isRamping, bool applyOutputGain>
+    void processSections (dsp::AudioBlock<IOType>& block)
+    {
+        const auto numLanes       = SIMDType::size();
+        const auto numBlockGroups = (block.getNumChannels() + numLanes - 1) / numLanes;
+
+        // every pass ramps the coefficients and fades again from the same start
+        if (isRamping && numBlockGroups > maxGroupsPerPass)
+            for (size_t i = 0; i < numActive; ++i)
+                saveRampStart (active [i]);
+
+        for (size_t group = 0; group < numBlockGroups;)
+        {
+            if (isRamping && group > 0)
+                for (size_t i = 0; i < numActive; ++i)
+                    restoreRampStart (active [i]);
+
+            switch (jmin (numBlockGroups - group, maxGroupsPerPass))
+            {
+                case 1:  processGroups<1, isRamping, applyOutputGain> (block, group); group += 1; break;
+                case 2:  processGroups<2, isRamping, applyOutputGain> (block, group); group += 2; break;
+                case 3:  processGroups<3, isRamping, applyOutputGain> (block, group); group += 3; break;
+                default: processGroups<4, isRamping, applyOutputGain> (block, group); group += 4; break;
+            }
+        }
+    }
+
+    /** Runs numRegisters groups of channels side by side. They share the coefficients and
+        their ramps, and their recursions don't depend on each other, so they overlap in the
+        pipeline instead of each waiting for its own previous sample. */
+    template<size_t numRegisters, bool isRamping, bool applyOutputGain>
+    void processGroups (dsp::AudioBlock<IOType>& block, size_t firstGroup)
+    {
+        const auto numLanes    = SIMDType::size();
+        const auto numSamples  = block.getNumSamples();
+        const auto first       = firstGroup * numLanes;
+        const auto numInPass   = jmin (numRegisters * numLanes, block.getNumChannels() - first);
+
+        SIMDType* c [numCoefficients];
+        std::copy (std::begin (coefficients), std::end (coefficients), std::begin (c));
+
+        // lanes without a channel keep reading silence, which stays silence through the sections
+        alignas (SIMDType) SampleType input  [numRegisters * SIMDType::SIMDNumElements] {};
+        alignas (SIMDType) SampleType output [numRegisters * SIMDType::SIMDNumElements] {};
+        IOType* channels [numRegisters * SIMDType::SIMDNumElements] {};
+        for (size_t ch = 0; ch < numInPass; ++ch)
+            channels [ch] = block.getChannelPointer (first + ch);
+
+        SIMDType* s1 [numRegisters];
+        SIMDType* s2 [numRegisters];
+        for (size_t r = 0; r < numRegisters; ++r)
+        {
+            s1 [r] = state + 2 * numSections * (firstGroup + r);
+            s2 [r] = s1 [r] + numSections;
+        }
+
+        SIMDType x [numRegisters];
+        auto currentGain = outputGain;
+
+        for (size_t n = 0; n < numSamples; ++n)
+        {
+            for (size_t ch = 0; ch < numInPass; ++ch)
+                input [ch] = static_cast<SampleType> (channels [ch][n]);
+
+            for (size_t r = 0; r < numRegisters; ++r)
+                x [r] = SIMDType::fromRawArray (input + r * numLanes);
+
+            for (size_t i = 0; i < numActive; ++i)
+            {
+                const auto s = active [i];
+
+                if (i == numLeftRight)
+                    for (auto& v : x)
+                        v = toMidSide (v);
+
+                if (isRamping && ramping [s])
+                    for (size_t k = 0; k < numCoefficients; ++k)
+                        coefficients [k][s] += increments [k][s];
+
+                if (isRamping && fading [s])
+                {
+                    mixes [s] += mixIncrements [s];
+                    for (size_t r = 0; r < numRegisters; ++r)
+                    {
+                        const auto y = Topology::processSample (x [r], c, s, s1 [r][s], s2 [r][s]);
+                        x [r] += mixes [s] * (y - x [r]);
+                    }
+                }
+                else
+                {
+                    for (size_t r = 0; r < numRegisters; ++r)
+                        x [r] = Topology::processSample (x [r], c, s, s1 [r][s], s2 [r][s]);
+                }
+            }
+
+            if (numActive > numLeftRight)
+                for (auto& v : x)
+                    v = toLeftRight (v);
+
+            if (applyOutputGain)
+            {
+                currentGain += outputIncrement;
+                const auto g = SIMDType::expand (currentGain);
+                for (auto& v : x)
+                    v = v * g;
+            }
+
+            for (size_t r = 0; r < numRegisters; ++r)
+                x [r].copyToRawArray (output + r * numLanes);
+
+            for (size_t ch = 0; ch < numInPass; ++ch)
+                channels [ch][n] = static_cast<IOType> (output [ch]);
+        }
+    }
+
+    void saveRampStart (size_t s)
+    {
+        if (ramping [s])
+            for (size_t k = 0; k < numCoefficients; ++k)
+                rampStarts [k][s] = coefficients [k][s];
+
+        if (fading [s])
+            mixStarts [s] = mixes [s];
+    }
+
+    void restoreRampStart (size_t s)
+    {
+        if (ramping [s])
+            for (size_t k = 0; k < numCoefficients; ++k)
+                coefficients [k][s] = rampStarts [k][s];
+
+        if (fading [s])
+            mixes [s] = mixStarts [s];
+    }
+
+    template<typename Type>
+    static Type* allocateAligned (HeapBlock<char>& data, size_t num)
+    {
+        data.calloc (num * sizeof (Type) + alignof (Type));
+        const auto address = reinterpret_cast<uintptr_t> (data.getData());
+        return reinterpret_cast<Type*> ((address + alignof (Type) - 1) & ~uintptr_t (alignof (Type) - 1));
+    }
+
+    static constexpr size_t numCoefficients = Topology::numCoefficients;
+
+    // 16 float or 8 double channels in one pass with SSE or NEON, twice that with AVX
+    static constexpr size_t maxGroupsPerPass = 4;
+
+    size_t               numSections = 0;
+    size_t               numGroups   = 0;
+
+    // current coefficients, ramp targets, per sample increments and ramp starts, as one array per coefficient
+    HeapBlock<char>      coefficientData;
+    SIMDType*            coefficients [numCoefficients] {};
+    SIMDType*            targets      [numCoefficients] {};
+    SIMDType*            increments   [numCoefficients] {};
+    SIMDType*            rampStarts   [numCoefficients] {};
+
+    // the state of all sections, both state variables one after the other for each channel group
+    HeapBlock<char>      stateData;
+    SIMDType*            state       = nullptr;
+
+    // the requested designs, and which of them still need to be ramped to
+    std::vector<Section> designs;
+    std::vector<bool>    pending;
+    std::vector<bool>    bypassed;
+    std::vector<bool>    wasBypassed;
+    std::vector<bool>    ramping;
+
+    // the crossfades of bypassed sections, wetLevels is where the current fade ends
+    static constexpr double fadeSeconds = 0.005;
+    SampleType              fadeStep    = 0;
+    std::vector<bool>       fading;
+    std::vector<SampleType> wetLevels;
+    HeapBlock<char>         mixData;
+    SIMDType*               mixes         = nullptr;
+    SIMDType*               mixIncrements = nullptr;
+    SIMDType*               mixStarts     = nullptr;
+
+    // the channels of each section, the ones it moves to after fading out, and how many
+    // of the active ones run on left and right
+    std::vector<ChannelRouting> routings;
+    std::vector<ChannelRouting> nextRoutings;
+    size_t                      numLeftRight = 0;
+
+    // sections that are not identity or still have state, only these are processed
+    std::vector<bool>    running;
+    std::vector<size_t>  active;
+    size_t               numActive   = 0;
+
+    // the output gain, in the numerator of gainSection, or on its own if that is numSections.
+    // While handingOver, previousGainSection carries part of it until handover reaches 1.
+    SampleType           gain            = 1;
+    SampleType           targetGain      = 1;
+    size_t               gainSection     = 0;
+    size_t               previousGainSection = 0;
+    bool                 handingOver     = false;
+    SampleType           handover        = 0;
+    SampleType           outputGain      = 1;
+    SampleType           outputTarget    = 1;
+    SampleType           outputIncrement = 0;
+
+    // the samples until the current ramps reach their targets, over one or more blocks
+    size_t               rampSamplesLeft = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterCascade)
+};
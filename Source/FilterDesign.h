@@ -0,0 +1,703 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer filter design
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FastMath.h"
+
+//==============================================================================
+/**
+    Designs the filter sections as plain values, so they can be computed on the
+    audio thread. Nothing in here touches the heap. The formulas are the ones
+    used by dsp::IIR::Coefficients, normalised so a0 is always 1. The bilinear
+    and state variable designs use FastMath instead of the standard library.
+*/
+namespace FilterDesign
+{
+
+template<typename Type>
+struct Biquad
+{
+    Type b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+};
+
+/** Returns true if the section passes the signal unchanged. */
+template<typename Type>
+bool isIdentity (const Biquad<Type>& c)
+{
+    return c.b0 == Type (1) && c.b1 == Type (0) && c.b2 == Type (0) && c.a1 == Type (0) && c.a2 == Type (0);
+}
+
+template<typename Type>
+Biquad<Type> normalise (double b0, double b1, double b2, double a0, double a1, double a2)
+{
+    const auto a0inv = 1.0 / a0;
+    return { Type (b0 * a0inv), Type (b1 * a0inv), Type (b2 * a0inv), Type (a1 * a0inv), Type (a2 * a0inv) };
+}
+
+template<typename Type>
+Biquad<Type> makeFirstOrderLowPass (double sampleRate, double frequency)
+{
+    const auto n = FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    return normalise<Type> (n, n, 0, n + 1, n - 1, 0);
+}
+
+template<typename Type>
+Biquad<Type> makeFirstOrderHighPass (double sampleRate, double frequency)
+{
+    const auto n = FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    return normalise<Type> (1, -1, 0, n + 1, n - 1, 0);
+}
+
+template<typename Type>
+Biquad<Type> makeFirstOrderAllPass (double sampleRate, double frequency)
+{
+    const auto n = FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    return normalise<Type> (n - 1, n + 1, 0, n + 1, n - 1, 0);
+}
+
+template<typename Type>
+Biquad<Type> makeLowPass (double sampleRate, double frequency, double quality)
+{
+    const auto n        = 1.0 / FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ     = 1.0 / quality;
+    const auto c1       = 1.0 / (1.0 + invQ * n + nSquared);
+
+    return { Type (c1), Type (c1 * 2.0), Type (c1),
+             Type (c1 * 2.0 * (1.0 - nSquared)), Type (c1 * (1.0 - invQ * n + nSquared)) };
+}
+
+template<typename Type>
+Biquad<Type> makeHighPass (double sampleRate, double frequency, double quality)
+{
+    const auto n        = FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ     = 1.0 / quality;
+    const auto c1       = 1.0 / (1.0 + invQ * n + nSquared);
+
+    return { Type (c1), Type (c1 * -2.0), Type (c1),
+             Type (c1 * 2.0 * (nSquared - 1.0)), Type (c1 * (1.0 - invQ * n + nSquared)) };
+}
+
+template<typename Type>
+Biquad<Type> makeBandPass (double sampleRate, double frequency, double quality)
+{
+    const auto n        = 1.0 / FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ     = 1.0 / quality;
+    const auto c1       = 1.0 / (1.0 + invQ * n + nSquared);
+
+    return { Type (c1 * n * invQ), Type (0), Type (-c1 * n * invQ),
+             Type (c1 * 2.0 * (1.0 - nSquared)), Type (c1 * (1.0 - invQ * n + nSquared)) };
+}
+
+template<typename Type>
+Biquad<Type> makeNotch (double sampleRate, double frequency, double quality)
+{
+    const auto n        = 1.0 / FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ     = 1.0 / quality;
+    const auto c1       = 1.0 / (1.0 + n * invQ + nSquared);
+    const auto b0       = c1 * (1.0 + nSquared);
+    const auto b1       = 2.0 * c1 * (1.0 - nSquared);
+
+    return { Type (b0), Type (b1), Type (b0), Type (b1), Type (c1 * (1.0 - n * invQ + nSquared)) };
+}
+
+template<typename Type>
+Biquad<Type> makeAllPass (double sampleRate, double frequency, double quality)
+{
+    const auto n        = 1.0 / FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+    const auto nSquared = n * n;
+    const auto invQ     = 1.0 / quality;
+    const auto c1       = 1.0 / (1.0 + invQ * n + nSquared);
+    const auto b0       = c1 * (1.0 - n * invQ + nSquared);
+    const auto b1       = c1 * 2.0 * (1.0 - nSquared);
+
+    return { Type (b0), Type (b1), Type (1), Type (b1), Type (b0) };
+}
+
+template<typename Type>
+Biquad<Type> makeLowShelf (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A       = jmax (0.0, std::sqrt (gainFactor));
+    const auto aminus1 = A - 1.0;
+    const auto aplus1  = A + 1.0;
+    const auto omega   = (2.0 * MathConstants<double>::pi * frequency) / sampleRate;
+    double sino, coso;
+    FastMath::sinCos (omega, sino, coso);
+    const auto beta    = sino * std::sqrt (A) / quality;
+    const auto aminus1TimesCoso = aminus1 * coso;
+
+    return normalise<Type> (A * (aplus1 - aminus1TimesCoso + beta),
+                            A * 2.0 * (aminus1 - aplus1 * coso),
+                            A * (aplus1 - aminus1TimesCoso - beta),
+                            aplus1 + aminus1TimesCoso + beta,
+                            -2.0 * (aminus1 + aplus1 * coso),
+                            aplus1 + aminus1TimesCoso - beta);
+}
+
+template<typename Type>
+Biquad<Type> makeHighShelf (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A       = jmax (0.0, std::sqrt (gainFactor));
+    const auto aminus1 = A - 1.0;
+    const auto aplus1  = A + 1.0;
+    const auto omega   = (2.0 * MathConstants<double>::pi * frequency) / sampleRate;
+    double sino, coso;
+    FastMath::sinCos (omega, sino, coso);
+    const auto beta    = sino * std::sqrt (A) / quality;
+    const auto aminus1TimesCoso = aminus1 * coso;
+
+    return normalise<Type> (A * (aplus1 + aminus1TimesCoso + beta),
+                            A * -2.0 * (aminus1 + aplus1 * coso),
+                            A * (aplus1 + aminus1TimesCoso - beta),
+                            aplus1 - aminus1TimesCoso + beta,
+                            2.0 * (aminus1 - aplus1 * coso),
+                            aplus1 - aminus1TimesCoso - beta);
+}
+
+template<typename Type>
+Biquad<Type> makePeakFilter (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A     = jmax (0.0, std::sqrt (gainFactor));
+    const auto omega = (2.0 * MathConstants<double>::pi * frequency) / sampleRate;
+    double sino, coso;
+    FastMath::sinCos (omega, sino, coso);
+    const auto alpha = sino / (quality * 2.0);
+    const auto c2    = -2.0 * coso;
+    const auto alphaTimesA = alpha * A;
+    const auto alphaOverA  = alpha / A;
+
+    return normalise<Type> (1.0 + alphaTimesA, c2, 1.0 - alphaTimesA, 1.0 + alphaOverA, c2, 1.0 - alphaOverA);
+}
+
+//==============================================================================
+/** Returns the inverse filter, only valid if the zeros are inside the unit circle. */
+template<typename Type>
+Biquad<Type> invert (const Biquad<Type>& c)
+{
+    return normalise<Type> (1.0, c.a1, c.a2, c.b0, c.b1, c.b2);
+}
+
+/** Designs a section with the poles of an analog resonance, mapped by impulse invariance,
+    and the zeros chosen so the magnitude matches the analog prototype at DC, at the match
+    frequency and at Nyquist. Unlike the bilinear transform this doesn't cramp the response
+    towards Nyquist (M. Vicanek, "Matched Second Order Digital Filters").
+    Frequencies are in radians per sample, squaredMagnitude returns the analog |H|^2. */
+template<typename Type, typename MagnitudeFunction>
+Biquad<Type> makeMatched (double poleOmega, double poleQuality, double matchOmega, MagnitudeFunction squaredMagnitude)
+{
+    const auto zeta = 0.5 / poleQuality;
+    const auto r    = std::exp (-zeta * poleOmega);
+    const auto a1   = zeta <= 1.0 ? -2.0 * r * std::cos  (std::sqrt (1.0 - zeta * zeta) * poleOmega)
+                                  : -2.0 * r * std::cosh (std::sqrt (zeta * zeta - 1.0) * poleOmega);
+    const auto a2   = r * r;
+
+    // |H|^2 = (B0 phi0 + B1 phi1 + B2 phi2) / (A0 phi0 + A1 phi1 + A2 phi2)
+    const auto A0 = (1.0 + a1 + a2) * (1.0 + a1 + a2);
+    const auto A1 = (1.0 - a1 + a2) * (1.0 - a1 + a2);
+    const auto A2 = -4.0 * a2;
+
+    const auto sine = std::sin (0.5 * matchOmega);
+    const auto phi1 = sine * sine;
+    const auto phi0 = 1.0 - phi1;
+    const auto phi2 = 4.0 * phi0 * phi1;
+
+    const auto B0 = squaredMagnitude (0.0) * A0;
+    const auto B1 = squaredMagnitude (MathConstants<double>::pi) * A1;
+    const auto B2 = (squaredMagnitude (matchOmega) * (A0 * phi0 + A1 * phi1 + A2 * phi2) - B0 * phi0 - B1 * phi1) / phi2;
+
+    const auto sqrtB0 = std::sqrt (B0);
+    const auto sqrtB1 = std::sqrt (B1);
+    const auto W  = 0.5 * (sqrtB0 + sqrtB1);
+    const auto b0 = 0.5 * (W + std::sqrt (jmax (0.0, W * W + B2)));
+    const auto b1 = 0.5 * (sqrtB0 - sqrtB1);
+    const auto b2 = -B2 / (4.0 * b0);
+
+    return { Type (b0), Type (b1), Type (b2), Type (a1), Type (a2) };
+}
+
+/** A cut is designed as the inverse of the boost, where the poles carry the wider bandwidth. */
+template<typename Type>
+Biquad<Type> makeMatchedPeakFilter (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    if (gainFactor < 1.0)
+        return invert (makeMatchedPeakFilter<Type> (sampleRate, frequency, quality, 1.0 / gainFactor));
+
+    const auto A      = jmax (0.0, std::sqrt (gainFactor));
+    const auto omega0 = MathConstants<double>::twoPi * frequency / sampleRate;
+
+    return makeMatched<Type> (omega0, A * quality, omega0, [=] (double omega)
+    {
+        const auto w  = omega / omega0;
+        const auto re = (1.0 - w * w) * (1.0 - w * w);
+        return (re + (A * w / quality) * (A * w / quality)) / (re + (w / (A * quality)) * (w / (A * quality)));
+    });
+}
+
+/** A cut is designed as the inverse of the boost, which keeps the poles below the corner frequency. */
+template<typename Type>
+Biquad<Type> makeMatchedLowShelf (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    if (gainFactor < 1.0)
+        return invert (makeMatchedLowShelf<Type> (sampleRate, frequency, quality, 1.0 / gainFactor));
+
+    const auto A      = std::sqrt (gainFactor);
+    const auto omega0 = MathConstants<double>::twoPi * frequency / sampleRate;
+
+    return makeMatched<Type> (omega0 / std::sqrt (A), quality, omega0, [=] (double omega)
+    {
+        const auto w2 = (omega / omega0) * (omega / omega0);
+        const auto damping = A * w2 / (quality * quality);
+        return A * A * ((A - w2) * (A - w2) + damping) / ((1.0 - A * w2) * (1.0 - A * w2) + damping);
+    });
+}
+
+template<typename Type>
+Biquad<Type> makeMatchedHighShelf (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    if (gainFactor > 1.0)
+        return invert (makeMatchedHighShelf<Type> (sampleRate, frequency, quality, 1.0 / gainFactor));
+
+    const auto A      = std::sqrt (gainFactor);
+    const auto omega0 = MathConstants<double>::twoPi * frequency / sampleRate;
+
+    return makeMatched<Type> (omega0 * std::sqrt (A), quality, omega0, [=] (double omega)
+    {
+        const auto w2 = (omega / omega0) * (omega / omega0);
+        const auto damping = A * w2 / (quality * quality);
+        return A * A * ((1.0 - A * w2) * (1.0 - A * w2) + damping) / ((A - w2) * (A - w2) + damping);
+    });
+}
+
+//==============================================================================
+/** The most sections a filter design can use, enough for a 96 dB/oct slope. */
+constexpr size_t maxSections = 8;
+
+/** A design made of several sections in series. Unused sections are identity. */
+template<typename Section>
+using Sections = std::array<Section, maxSections>;
+
+/** Adds the sections of a Butterworth low or high pass, ordered by rising Q. The quality
+    scales the Q of the most resonant section, 1/sqrt2 keeps the maximally flat response. */
+template<typename Type>
+size_t addButterworth (Sections<Biquad<Type>>& sections, size_t first, bool highPass, int order,
+                       double sampleRate, double frequency, double quality)
+{
+    jassert (first + size_t (order + 1) / 2 <= maxSections);
+
+    auto index = first;
+    if (order % 2 == 1)
+        sections [index++] = highPass ? makeFirstOrderHighPass<Type> (sampleRate, frequency)
+                                      : makeFirstOrderLowPass<Type>  (sampleRate, frequency);
+
+    for (int k = 1; k <= order / 2; ++k)
+    {
+        // angle of the pole pair from the negative real axis
+        const auto angle = MathConstants<double>::pi * (2 * k - 1 + order % 2) / (2.0 * order);
+        auto q = 0.5 / std::cos (angle);
+        if (k == order / 2)
+            q *= quality * MathConstants<double>::sqrt2;
+
+        sections [index++] = highPass ? makeHighPass<Type> (sampleRate, frequency, q)
+                                      : makeLowPass<Type>  (sampleRate, frequency, q);
+    }
+    return index;
+}
+
+template<typename Type>
+Sections<Biquad<Type>> makeButterworth (bool highPass, int order, double sampleRate, double frequency, double quality)
+{
+    Sections<Biquad<Type>> sections;
+    addButterworth (sections, 0, highPass, order, sampleRate, frequency, quality);
+    return sections;
+}
+
+/** A Linkwitz-Riley filter is a Butterworth of half the order applied twice. */
+template<typename Type>
+Sections<Biquad<Type>> makeLinkwitzRiley (bool highPass, int order, double sampleRate, double frequency)
+{
+    jassert (order % 2 == 0);
+
+    Sections<Biquad<Type>> sections;
+    const auto flat = 1.0 / MathConstants<double>::sqrt2;
+    const auto next = addButterworth (sections, 0, highPass, order / 2, sampleRate, frequency, flat);
+    addButterworth (sections, next, highPass, order / 2, sampleRate, frequency, flat);
+    return sections;
+}
+
+//==============================================================================
+/**
+    Coefficients of a trapezoidal state variable filter section (A. Simper, "Linear
+    Trapezoidal Integrated State Variable Filter"). a1, a2 and a3 follow from the
+    prewarped frequency g and the damping k, the output mixes the input with the
+    band and low pass outputs. Changing them only needs a tan and a few multiplies,
+    and the topology stays well behaved when they are modulated.
+    Identity holds the integrators and passes the input.
+*/
+template<typename Type>
+struct Svf
+{
+    Type a1 = 1, a2 = 0, a3 = 0, m0 = 1, m1 = 0, m2 = 0;
+};
+
+template<typename Type>
+bool isIdentity (const Svf<Type>& c)
+{
+    return c.m0 == Type (1) && c.m1 == Type (0) && c.m2 == Type (0);
+}
+
+template<typename Type>
+Svf<Type> makeSvf (double g, double k, double m0, double m1, double m2)
+{
+    const auto a1 = 1.0 / (1.0 + g * (g + k));
+    const auto a2 = g * a1;
+    return { Type (a1), Type (a2), Type (g * a2), Type (m0), Type (m1), Type (m2) };
+}
+
+/** A first order section only uses the low pass integrator. */
+template<typename Type>
+Svf<Type> makeFirstOrderSvf (double g, double m0, double m2)
+{
+    return { Type (1), Type (0), Type (g / (1.0 + g)), Type (m0), Type (0), Type (m2) };
+}
+
+inline double getSvfFrequency (double sampleRate, double frequency)
+{
+    return FastMath::tan (MathConstants<double>::pi * frequency / sampleRate);
+}
+
+template<typename Type>
+Svf<Type> makeSvfFirstOrderLowPass (double sampleRate, double frequency)
+{
+    return makeFirstOrderSvf<Type> (getSvfFrequency (sampleRate, frequency), 0.0, 1.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfFirstOrderHighPass (double sampleRate, double frequency)
+{
+    return makeFirstOrderSvf<Type> (getSvfFrequency (sampleRate, frequency), 1.0, -1.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfFirstOrderAllPass (double sampleRate, double frequency)
+{
+    return makeFirstOrderSvf<Type> (getSvfFrequency (sampleRate, frequency), -1.0, 2.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfLowPass (double sampleRate, double frequency, double quality)
+{
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency), 1.0 / quality, 0.0, 0.0, 1.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfHighPass (double sampleRate, double frequency, double quality)
+{
+    const auto k = 1.0 / quality;
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency), k, 1.0, -k, -1.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfBandPass (double sampleRate, double frequency, double quality)
+{
+    const auto k = 1.0 / quality;
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency), k, 0.0, k, 0.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfNotch (double sampleRate, double frequency, double quality)
+{
+    const auto k = 1.0 / quality;
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency), k, 1.0, -k, 0.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfAllPass (double sampleRate, double frequency, double quality)
+{
+    const auto k = 1.0 / quality;
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency), k, 1.0, -2.0 * k, 0.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfPeakFilter (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A = jmax (0.0, std::sqrt (gainFactor));
+    const auto k = 1.0 / (quality * A);
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency), k, 1.0, k * (A * A - 1.0), 0.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfLowShelf (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A = jmax (0.0, std::sqrt (gainFactor));
+    const auto k = 1.0 / quality;
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency) / std::sqrt (A), k, 1.0, k * (A - 1.0), A * A - 1.0);
+}
+
+template<typename Type>
+Svf<Type> makeSvfHighShelf (double sampleRate, double frequency, double quality, double gainFactor)
+{
+    const auto A = jmax (0.0, std::sqrt (gainFactor));
+    const auto k = 1.0 / quality;
+    return makeSvf<Type> (getSvfFrequency (sampleRate, frequency) * std::sqrt (A), k, A * A, k * (1.0 - A) * A, 1.0 - A * A);
+}
+
+/** Converts a stable biquad to the state variable filter with the same response. */
+template<typename Type, typename OtherType>
+Svf<Type> toSvf (const Biquad<OtherType>& c)
+{
+    if (isIdentity (c))
+        return {};
+
+    const double b0 = c.b0, b1 = c.b1, b2 = c.b2, a1 = c.a1, a2 = c.a2;
+
+    if (a2 == 0.0 && b2 == 0.0)
+    {
+        const auto g  = (1.0 + a1) / (1.0 - a1);
+        const auto m0 = 0.5 * (b0 - b1) * (1.0 + g);
+        return makeFirstOrderSvf<Type> (g, m0, (b0 - m0) * (1.0 + g) / g);
+    }
+
+    // the denominator 1 + g^2 + gk relative to the normalised a0
+    const auto d  = 4.0 / (1.0 - a1 + a2);
+    const auto g  = std::sqrt ((1.0 + a1 + a2) / (1.0 - a1 + a2));
+    const auto gk = 0.5 * (1.0 - a2) * d;
+    const auto m0 = 0.25 * d * (b0 - b1 + b2);
+    const auto m2 = 0.25 * d * (b0 + b1 + b2) / (g * g) - m0;
+    const auto m1 = ((b0 - b2) * d - 2.0 * gk * m0) / (2.0 * g);
+    return makeSvf<Type> (g, gk / g, m0, m1, m2);
+}
+
+/** Converts a state variable filter section to the biquad with the same response. */
+template<typename Type>
+Biquad<double> toBiquad (const Svf<Type>& c)
+{
+    if (isIdentity (c))
+        return {};
+
+    const double a1 = c.a1, a2 = c.a2, a3 = c.a3, m0 = c.m0, m1 = c.m1, m2 = c.m2;
+
+    if (a2 == 0.0)
+    {
+        // first order, a3 is g / (1 + g)
+        return { m0 + m2 * a3, m0 * (2.0 * a3 - 1.0) + m2 * a3, 0.0, 2.0 * a3 - 1.0, 0.0 };
+    }
+
+    const auto g  = a2 / a1;
+    const auto d  = 1.0 / a1;
+    const auto gk = d - 1.0 - g * g;
+    return normalise<double> (m0 * d + m1 * g + m2 * g * g,
+                              2.0 * m0 * (g * g - 1.0) + 2.0 * m2 * g * g,
+                              m0 * (1.0 + g * g - gk) - m1 * g + m2 * g * g,
+                              d, 2.0 * (g * g - 1.0), 1.0 + g * g - gk);
+}
+
+//==============================================================================
+/** Returns the first n from which on a bound that falls after n = first stays below the
+    attenuation, or 0 if it never gets above it. */
+template<typename Bound>
+double findDecay (Bound&& bound, double first, double attenuation, double maxSamples)
+{
+    if (bound (first) <= attenuation)
+        return 0.0;
+
+    // step out until the bound is below, then bisect to half a sample
+    auto above = first;
+    auto below = first + 1.0;
+    while (bound (below) > attenuation)
+    {
+        if (below >= maxSamples)
+            return maxSamples;
+
+        above = below;
+        below = first + 2.0 * (below - first);
+    }
+
+    while (below - above > 0.5)
+    {
+        const auto middle = 0.5 * (above + below);
+        (bound (middle) > attenuation ? above : below) = middle;
+    }
+
+    return below;
+}
+
+/** Returns the seconds the impulse response of a section takes to decay by the attenuation
+    factor, at the sample rate it was designed for.
+
+    With the poles p and q and the numerator N (z) = b0 z^2 + b1 z + b2, the response is
+    h[n] = (N (p) p^(n-1) - N (q) q^(n-1)) / (p - q) after the first sample, which two
+    bounds hold, and the decay is the sooner of them:
+
+    - Each pole rings on its own, |h[n]| <= (|N (p)| |p|^(n-1) + |N (q)| |q|^(n-1)) / |p - q|,
+      which is tight when the poles are apart. A slow pole nearly cancelled by a zero only
+      counts with its small residue.
+    - h[n] is the slope of N (z) z^(n-1) between the poles, so it is bounded by the largest
+      derivative N' (z) z^(n-1) + (n-1) N (z) z^(n-2) on the way. That holds for repeated poles,
+      where the residues grow without bound, and the response rises with n before the radius
+      takes over. */
+template<typename Type>
+double getDecaySeconds (const Biquad<Type>& c, double sampleRate, double attenuation)
+{
+    // marginally stable poles would ring forever, they count as a minute
+    const auto maxSeconds = 60.0;
+    const auto maxSamples = maxSeconds * sampleRate;
+
+    if (isIdentity (c))
+        return 0.0;
+
+    using Complex = std::complex<double>;
+    const double a1 = c.a1, a2 = c.a2;
+    const auto root = std::sqrt (Complex (a1 * a1 - 4.0 * a2));
+    const auto p = 0.5 * (-a1 + root);
+    const auto q = 0.5 * (-a1 - root);
+
+    const auto radius = jmax (std::abs (p), std::abs (q));
+    if (radius >= 1.0)
+        return maxSeconds;
+
+    // no poles, only the numerator
+    if (radius < 1.0e-9)
+        return 3.0 / sampleRate;
+
+    const auto numerator  = [&c] (Complex z) { return (double (c.b0) * z + double (c.b1)) * z + double (c.b2); };
+    const auto derivative = [&c] (Complex z) { return 2.0 * double (c.b0) * z + double (c.b1); };
+
+    // the bounds are in m = n - 1, between the poles N and N' differ from the middle by at
+    // most their Taylor terms, and |z| is at most the radius
+    const auto middle   = 0.5 * (p + q);
+    const auto distance = 0.5 * std::abs (p - q);
+    const auto b0       = std::abs (double (c.b0));
+    const auto maxSlope = std::abs (derivative (middle)) + 2.0 * b0 * distance;
+    const auto maxValue = std::abs (numerator (middle)) + std::abs (derivative (middle)) * distance + b0 * distance * distance;
+    const auto rate     = -std::log (radius);
+
+    const auto rising = [=] (double m) { return (maxSlope + m * maxValue / radius) * std::exp (-rate * m); };
+    const auto peak   = maxValue > 0.0 ? jmax (0.0, 1.0 / rate - maxSlope * radius / maxValue) : 0.0;
+    auto decay = findDecay (rising, peak, attenuation, maxSamples);
+
+    if (distance > 0.0)
+    {
+        double amplitudes [2], rates [2];
+        size_t numPoles = 0;
+        for (const auto& pole : { p, q })
+        {
+            // a pole at zero only adds to the first sample
+            if (std::abs (pole) < 1.0e-9)
+                continue;
+
+            amplitudes [numPoles] = std::abs (numerator (pole)) / (2.0 * distance);
+            rates [numPoles]      = -std::log (std::abs (pole));
+            ++numPoles;
+        }
+
+        const auto ringing = [&] (double m)
+        {
+            double sum = 0;
+            for (size_t i = 0; i < numPoles; ++i)
+                sum += amplitudes [i] * std::exp (-rates [i] * m);
+            return sum;
+        };
+        decay = jmin (decay, findDecay (ringing, 0.0, attenuation, maxSamples));
+    }
+
+    return jmin ((3.0 + decay) / sampleRate, maxSeconds);
+}
+
+/** The decay times of sections in series are added, which bounds the longer tail of the cascade. */
+template<typename Type>
+double getDecaySeconds (const Sections<Biquad<Type>>& sections, double sampleRate, double attenuation)
+{
+    double seconds = 0;
+    for (const auto& c : sections)
+        seconds += getDecaySeconds (c, sampleRate, attenuation);
+
+    return seconds;
+}
+
+//==============================================================================
+template<typename Type>
+double getMagnitudeForFrequency (const Biquad<Type>& c, double frequency, double sampleRate)
+{
+    const auto z1 = std::polar (1.0, -MathConstants<double>::twoPi * frequency / sampleRate);
+    const auto z2 = z1 * z1;
+
+    const auto numerator   = double (c.b0) + double (c.b1) * z1 + double (c.b2) * z2;
+    const auto denominator = 1.0 + double (c.a1) * z1 + double (c.a2) * z2;
+
+    return std::abs (numerator / denominator);
+}
+
+template<typename Type>
+double getMagnitudeForFrequency (const Svf<Type>& c, double frequency, double sampleRate)
+{
+    return getMagnitudeForFrequency (toBiquad (c), frequency, sampleRate);
+}
+
+/** Multiplies the magnitudes with the response at the points z^-1 = cosines - i * sines. */
+template<typename Type>
+void multiplyMagnitudes (const Biquad<Type>& c, const double* cosines, const double* sines, double* magnitudes, size_t numSamples)
+{
+    const double b0 = c.b0, b1 = c.b1, b2 = c.b2, a1 = c.a1, a2 = c.a2;
+    for (size_t i = 0; i < numSamples; ++i)
+    {
+        // z^-2 = cos 2w - i sin 2w
+        const auto cos2 = 2.0 * cosines [i] * cosines [i] - 1.0;
+        const auto sin2 = 2.0 * sines [i] * cosines [i];
+        const auto numeratorRe   = b0 + b1 * cosines [i] + b2 * cos2;
+        const auto numeratorIm   = b1 * sines [i] + b2 * sin2;
+        const auto denominatorRe = 1.0 + a1 * cosines [i] + a2 * cos2;
+        const auto denominatorIm = a1 * sines [i] + a2 * sin2;
+        magnitudes [i] *= std::sqrt ((numeratorRe * numeratorRe + numeratorIm * numeratorIm)
+                                     / (denominatorRe * denominatorRe + denominatorIm * denominatorIm));
+    }
+}
+
+template<typename Type>
+void multiplyMagnitudes (const Svf<Type>& c, const double* cosines, const double* sines, double* magnitudes, size_t numSamples)
+{
+    multiplyMagnitudes (toBiquad (c), cosines, sines, magnitudes, numSamples);
+}
+
+template<typename Type>
+void getMagnitudeForFrequencyArray (const Biquad<Type>& c, const double* frequencies, double* magnitudes,
+                                    size_t numSamples, double sampleRate)
+{
+    for (size_t i = 0; i < numSamples; ++i)
+        magnitudes [i] = getMagnitudeForFrequency (c, frequencies [i], sampleRate);
+}
+
+template<typename Section>
+void getMagnitudeForFrequencyArray (const Sections<Section>& sections, const double* frequencies, double* magnitudes,
+                                    size_t numSamples, double sampleRate)
+{
+    std::fill (magnitudes, magnitudes + numSamples, 1.0);
+
+    // the points on the unit circle are computed in batches for all sections, on the stack
+    const size_t chunkSize = 64;
+    double sines [chunkSize], cosines [chunkSize];
+
+    for (size_t start = 0; start < numSamples; start += chunkSize)
+    {
+        const auto num = jmin (chunkSize, numSamples - start);
+        for (size_t i = 0; i < num; ++i)
+            cosines [i] = MathConstants<double>::twoPi * jmin (frequencies [start + i], 0.5 * sampleRate) / sampleRate;
+
+        FastMath::sinCos (cosines, sines, cosines, num);
+
+        for (const auto& c : sections)
+            if (! isIdentity (c))
+                multiplyMagnitudes (c, cosines, sines, magnitudes + start, num);
+    }
+}
+
+} // namespace FilterDesign
@@ -12,6 +12,7 @@
 #include "FrequalizerEditor.h"
 
 static int   clickRadius = 4;
+static int   minBandEditorWidth = 100;
 static float maxDB       = 24.0f;
 
 //==============================================================================
@@ -25,8 +26,11 @@ FrequalizerAudioProcessorEditor::FrequalizerAudioProcessorEditor (FrequalizerAud
 
     for (size_t i=0; i < processor.getNumBands(); ++i) {
         auto* bandEditor = bandEditors.add (new BandEditor (i, processor));
-        addAndMakeVisible (bandEditor);
+        bandsContent.addAndMakeVisible (bandEditor);
     }
+    bandsView.setViewedComponent (&bandsContent, false);
+    bandsView.setScrollBarsShown (false, true);
+    addAndMakeVisible (bandsView);
 
     frame.setText (TRANS ("Output"));
     frame.setTextLabelPosition (Justification::centred);
@@ -35,6 +39,40 @@ FrequalizerAudioProcessorEditor::FrequalizerAudioProcessorEditor (FrequalizerAud
     attachments.add (new AudioProcessorValueTreeState::SliderAttachment (processor.getPluginState(), FrequalizerAudioProcessor::paramOutput, output));
     output.setTooltip (TRANS ("Overall Gain"));
 
+    if (auto* choiceParameter = dynamic_cast<AudioParameterChoice*>(processor.getPluginState().getParameter (FrequalizerAudioProcessor::paramPrecision)))
+        precision.addItemList (choiceParameter->choices, 1);
+
+    addAndMakeVisible (precision);
+    boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), FrequalizerAudioProcessor::paramPrecision, precision));
+    precision.setTooltip (TRANS ("Precision of the filters, 64 bit hosts always filter in 64 bit"));
+
+    if (auto* choiceParameter = dynamic_cast<AudioParameterChoice*>(processor.getPluginState().getParameter (FrequalizerAudioProcessor::paramDesign)))
+        design.addItemList (choiceParameter->choices, 1);
+
+    addAndMakeVisible (design);
+    boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), FrequalizerAudioProcessor::paramDesign, design));
+    design.setTooltip (TRANS ("Analog matched peaks and shelves keep their shape close to Nyquist"));
+
+    if (auto* choiceParameter = dynamic_cast<AudioParameterChoice*>(processor.getPluginState().getParameter (FrequalizerAudioProcessor::paramTopology)))
+        topology.addItemList (choiceParameter->choices, 1);
+
+    addAndMakeVisible (topology);
+    boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), FrequalizerAudioProcessor::paramTopology, topology));
+    topology.setTooltip (TRANS ("State variable filters follow fast automation more smoothly"));
+
+    if (auto* choiceParameter = dynamic_cast<AudioParameterChoice*>(processor.getPluginState().getParameter (FrequalizerAudioProcessor::paramEngine)))
+        engine.addItemList (choiceParameter->choices, 1);
+
+    addAndMakeVisible (engine);
+    boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), FrequalizerAudioProcessor::paramEngine, engine));
+    engine.setTooltip (TRANS ("Linear phase keeps the phase response intact for mastering, spectral runs any number of bands at a fixed cost, both add latency"));
+
+    // the items are the taps, offset by two, as the first one is -1 for all channels
+    addAndMakeVisible (analyserTap);
+    analyserTap.onChange = [this] { processor.setAnalyserTap (analyserTap.getSelectedId() - 2); };
+    analyserTap.setTooltip (TRANS ("Channels the analyser shows, summed"));
+    updateAnalyserTaps();
+
     auto size = processor.getSavedSize();
     setResizable (true, true);
     setSize (size.x, size.y);
@@ -136,11 +174,26 @@ void FrequalizerAudioProcessorEditor::resized()
 
     auto bandSpace = plotFrame.removeFromBottom (getHeight() / 2);
     auto width = roundToInt (bandSpace.getWidth()) / (bandEditors.size() + 1);
-    for (auto* bandEditor : bandEditors)
-        bandEditor->setBounds (bandSpace.removeFromLeft (width));
+    bandsView.setBounds (bandSpace.removeFromLeft (width * bandEditors.size()));
+
+    // with many bands the editors get a minimum width and scroll
+    auto editorWidth = jmax (width, minBandEditorWidth);
+    auto contentHeight = bandsView.getHeight();
+    if (editorWidth > width)
+        contentHeight -= bandsView.getScrollBarThickness();
+
+    bandsContent.setSize (editorWidth * bandEditors.size(), contentHeight);
+    for (int i=0; i < bandEditors.size(); ++i)
+        bandEditors.getUnchecked (i)->setBounds (i * editorWidth, 0, editorWidth, contentHeight);
 
     frame.setBounds (bandSpace.removeFromTop (bandSpace.getHeight() / 2));
-    output.setBounds (frame.getBounds().reduced (8));
+    auto outputArea = frame.getBounds().reduced (8);
+    analyserTap.setBounds (outputArea.removeFromBottom (20));
+    engine.setBounds (outputArea.removeFromBottom (20));
+    topology.setBounds (outputArea.removeFromBottom (20));
+    design.setBounds (outputArea.removeFromBottom (20));
+    precision.setBounds (outputArea.removeFromBottom (20));
+    output.setBounds (outputArea);
 
     plotFrame.reduce (3, 3);
     brandingFrame = bandSpace.reduced (5);
@@ -159,6 +212,14 @@ void FrequalizerAudioProcessorEditor::timerCallback()
 {
     if (processor.checkForNewAnalyserData())
         repaint (plotFrame);
+
+    // the host can change the layout while the editor is open
+    if (processor.getChannelLayoutOfBus (false, 0) != analyserTapLayout)
+    {
+        updateAnalyserTaps();
+        updateFrequencyResponses();
+        repaint();
+    }
 }
 
 void FrequalizerAudioProcessorEditor::mouseDown (const MouseEvent& e)
@@ -207,7 +268,7 @@ void FrequalizerAudioProcessorEditor::mouseMove (const MouseEvent& e)
                     if (std::abs (getPositionForGain (float (band->gain), plotFrame.getY(), plotFrame.getBottom())
                                   - e.position.getY()) < clickRadius)
                     {
-                        draggingGain = processor.getPluginState().getParameter (processor.getGainParamName (size_t (i)));
+                        draggingGain = processor.getBandParameter (size_t (i), FrequalizerAudioProcessor::BandGain) != nullptr;
                         setMouseCursor (MouseCursor (MouseCursor::UpDownLeftRightResizeCursor));
                     }
                     else
@@ -253,7 +314,7 @@ void FrequalizerAudioProcessorEditor::mouseDoubleClick (const MouseEvent& e)
                 if (std::abs (plotFrame.getX() + getPositionForFrequency (float (band->frequency)) * plotFrame.getWidth()
                               - e.position.getX()) < clickRadius)
                 {
-                    if (auto* param = processor.getPluginState().getParameter (processor.getActiveParamName (i)))
+                    if (auto* param = processor.getBandParameter (i, FrequalizerAudioProcessor::BandActive))
                         param->setValueNotifyingHost (param->getValue() < 0.5f ? 1.0f : 0.0f);
                 }
             }
@@ -276,11 +337,31 @@ void FrequalizerAudioProcessorEditor::updateFrequencyResponses ()
             processor.createFrequencyPlot (bandEditor->frequencyResponse, band->magnitudes, plotFrame.withX (plotFrame.getX() + 1), pixelsPerDouble);
         }
         bandEditor->updateSoloState (processor.getBandSolo (i));
+        bandEditor->updateRoutingState (processor.isRoutingAvailable());
     }
     frequencyResponse.clear();
     processor.createFrequencyPlot (frequencyResponse, processor.getMagnitudes(), plotFrame, pixelsPerDouble);
 }
 
+void FrequalizerAudioProcessorEditor::updateAnalyserTaps ()
+{
+    analyserTapNames  = processor.getAnalyserTapNames();
+    analyserTapLayout = processor.getChannelLayoutOfBus (false, 0);
+
+    analyserTap.clear (dontSendNotification);
+    analyserTap.addItemList (analyserTapNames, 1);
+
+    // a pair the layout doesn't have anymore falls back to all channels
+    auto selected = processor.getAnalyserTap() + 2;
+    if (selected > analyserTapNames.size())
+    {
+        selected = 1;
+        processor.setAnalyserTap (-1);
+    }
+
+    analyserTap.setSelectedId (selected, dontSendNotification);
+}
+
 float FrequalizerAudioProcessorEditor::getPositionForFrequency (float freq)
 {
     return (std::log (freq / 20.0f) / std::log (2.0f)) / 10.0f;
@@ -324,6 +405,16 @@ FrequalizerAudioProcessorEditor::BandEditor::BandEditor (size_t i, FrequalizerAu
     addAndMakeVisible (filterType);
     boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), processor.getTypeParamName (index), filterType));
 
+    slope.addItemList (FrequalizerAudioProcessor::getSlopeNames(), 1);
+    addAndMakeVisible (slope);
+    boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), processor.getSlopeParamName (index), slope));
+    slope.setTooltip (TRANS ("Slope of the high and low pass"));
+
+    routing.addItemList (FrequalizerAudioProcessor::getRoutingNames(), 1);
+    addAndMakeVisible (routing);
+    boxAttachments.add (new AudioProcessorValueTreeState::ComboBoxAttachment (processor.getPluginState(), processor.getRoutingParamName (index), routing));
+    routing.setTooltip (TRANS ("Channels the filter works on, only on a stereo layout"));
+
     addAndMakeVisible (frequency);
     attachments.add (new AudioProcessorValueTreeState::SliderAttachment (processor.getPluginState(), processor.getFrequencyParamName (index), frequency));
     frequency.setTooltip (TRANS ("Filter's frequency"));
@@ -357,6 +448,8 @@ void FrequalizerAudioProcessorEditor::BandEditor::resized ()
     bounds.reduce (10, 20);
 
     filterType.setBounds (bounds.removeFromTop (20));
+    slope.setBounds (bounds.removeFromTop (20));
+    routing.setBounds (bounds.removeFromTop (20));
 
     auto freqBounds = bounds.removeFromBottom (bounds.getHeight() * 2 / 3);
     frequency.setBounds (freqBounds.withTop (freqBounds.getY() + 10));
@@ -411,6 +504,8 @@ void FrequalizerAudioProcessorEditor::BandEditor::updateControls (FrequalizerAud
             gain.setEnabled (true);
             break;
     }
+
+    slope.setEnabled (type == FrequalizerAudioProcessor::LowPass || type == FrequalizerAudioProcessor::HighPass);
 }
 
 void FrequalizerAudioProcessorEditor::BandEditor::updateSoloState (bool isSolo)
@@ -418,6 +513,11 @@ void FrequalizerAudioProcessorEditor::BandEditor::updateSoloState (bool isSolo)
     solo.setToggleState (isSolo, dontSendNotification);
 }
 
+void FrequalizerAudioProcessorEditor::BandEditor::updateRoutingState (bool isAvailable)
+{
+    routing.setEnabled (isAvailable);
+}
+
 void FrequalizerAudioProcessorEditor::BandEditor::setFrequency (float freq)
 {
     frequency.setValue (freq, sendNotification);
@@ -8,7 +8,7 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
+#include <JuceHeader.h>
 #include "FrequalizerProcessor.h"
 
 
@@ -51,6 +51,8 @@ public:
 
         void updateSoloState (bool isSolo);
 
+        void updateRoutingState (bool isAvailable);
+
         void setFrequency (float frequency);
 
         void setGain (float gain);
@@ -68,6 +70,8 @@ public:
 
         GroupComponent      frame;
         ComboBox            filterType;
+        ComboBox            slope;
+        ComboBox            routing;
         Slider              frequency;
         Slider              quality;
         Slider              gain;
@@ -82,6 +86,9 @@ private:
 
     void updateFrequencyResponses ();
 
+    /** Lists the channel pairs of the current layout to tap the analysers at. */
+    void updateAnalyserTaps ();
+
     static float getPositionForFrequency (float freq);
 
     static float getFrequencyForPosition (float pos);
@@ -101,6 +108,8 @@ private:
 #endif
 
     OwnedArray<BandEditor>  bandEditors;
+    Component               bandsContent;
+    Viewport                bandsView;
 
     Rectangle<int>          plotFrame;
     Rectangle<int>          brandingFrame;
@@ -110,6 +119,13 @@ private:
 
     GroupComponent          frame;
     Slider                  output;
+    ComboBox                precision;
+    ComboBox                design;
+    ComboBox                topology;
+    ComboBox                engine;
+    ComboBox                analyserTap;
+    StringArray             analyserTapNames;
+    AudioChannelSet         analyserTapLayout;      // the layout the names were made for
 
     SocialButtons           socialButtons;
 
@@ -117,6 +133,7 @@ private:
     bool                    draggingGain = false;
 
     OwnedArray<AudioProcessorValueTreeState::SliderAttachment> attachments;
+    OwnedArray<AudioProcessorValueTreeState::ComboBoxAttachment> boxAttachments;
     SharedResourcePointer<TooltipWindow> tooltipWindow;
 
     PopupMenu               contextMenu;
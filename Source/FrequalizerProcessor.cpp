@@ -13,17 +13,27 @@
 
 
 String FrequalizerAudioProcessor::paramOutput   ("output");
+String FrequalizerAudioProcessor::paramPrecision("precision");
+String FrequalizerAudioProcessor::paramDesign   ("design");
+String FrequalizerAudioProcessor::paramTopology ("topology");
+String FrequalizerAudioProcessor::paramEngine   ("engine");
 String FrequalizerAudioProcessor::paramType     ("type");
 String FrequalizerAudioProcessor::paramFrequency("frequency");
 String FrequalizerAudioProcessor::paramQuality  ("quality");
 String FrequalizerAudioProcessor::paramGain     ("gain");
 String FrequalizerAudioProcessor::paramActive   ("active");
+String FrequalizerAudioProcessor::paramSlope    ("slope");
+String FrequalizerAudioProcessor::paramRouting  ("routing");
+
+static_assert (FREQUALIZER_NUM_BANDS > 0 && FREQUALIZER_NUM_BANDS <= FrequalizerAudioProcessor::maxNumBands,
+               "FREQUALIZER_NUM_BANDS must be between 1 and FrequalizerAudioProcessor::maxNumBands");
 
 namespace IDs
 {
     String editor {"editor"};
     String sizeX  {"size-x"};
     String sizeY  {"size-y"};
+    String tap    {"analyser-tap"};
 }
 
 String FrequalizerAudioProcessor::getBandID (size_t index)
@@ -38,20 +48,50 @@ String FrequalizerAudioProcessor::getBandID (size_t index)
         case 5: return "Highest";
         default: break;
     }
+    if (index < maxNumBands)
+        return "Band " + String (index + 1);
+
     return "unknown";
 }
 
-int FrequalizerAudioProcessor::getBandIndexFromID (String paramID)
+String FrequalizerAudioProcessor::getBandParamName (size_t index, BandParameter parameter)
+{
+    const String* names[] = { &paramType, &paramFrequency, &paramQuality, &paramGain, &paramActive, &paramSlope, &paramRouting };
+    static_assert (sizeof (names) / sizeof (names [0]) == NumBandParameters, "a name for each band parameter");
+
+    return getBandID (index) + "-" + *names [parameter];
+}
+
+int FrequalizerAudioProcessor::getBandIndexFromID (const String& paramID) const
+{
+    const auto index = getParameterIndex (paramID);
+    return index < 0 ? -1 : parameterTable [size_t (index)].band;
+}
+
+AudioProcessorParameter* FrequalizerAudioProcessor::getBandParameter (size_t index, BandParameter parameter) const
+{
+    if (isPositiveAndBelow (index, bands.size()))
+        return parameterTable [getParameterIndex (index, parameter)].parameter;
+    return nullptr;
+}
+
+void FrequalizerAudioProcessor::addParameterEntry (const String& paramID, int band)
 {
-    for (size_t i=0; i < 6; ++i)
-        if (paramID.startsWith (getBandID (i) + "-"))
-            return int (i);
+    jassert (state.getParameter (paramID) != nullptr);
+    parameterIndices.set (paramID, int (parameterTable.size()));
+    parameterTable.push_back ({ state.getParameter (paramID), state.getRawParameterValue (paramID), band });
+    state.addParameterListener (paramID, this);
+}
 
-    return -1;
+int FrequalizerAudioProcessor::getParameterIndex (const String& paramID) const
+{
+    return parameterIndices.contains (paramID) ? parameterIndices [paramID] : -1;
 }
 
-std::vector<FrequalizerAudioProcessor::Band> createDefaultBands()
+std::vector<FrequalizerAudioProcessor::Band> createDefaultBands (size_t numBands)
 {
+    jassert (numBands <= FrequalizerAudioProcessor::maxNumBands);
+
     std::vector<FrequalizerAudioProcessor::Band> defaults;
     defaults.push_back (FrequalizerAudioProcessor::Band (TRANS ("Lowest"),    Colours::blue,   FrequalizerAudioProcessor::HighPass,    20.0f, 0.707f));
     defaults.push_back (FrequalizerAudioProcessor::Band (TRANS ("Low"),       Colours::brown,  FrequalizerAudioProcessor::LowShelf,   250.0f, 0.707f));
@@ -59,16 +99,29 @@ std::vector<FrequalizerAudioProcessor::Band> createDefaultBands()
     defaults.push_back (FrequalizerAudioProcessor::Band (TRANS ("High Mids"), Colours::coral,  FrequalizerAudioProcessor::Peak,      1000.0f, 0.707f));
     defaults.push_back (FrequalizerAudioProcessor::Band (TRANS ("High"),      Colours::orange, FrequalizerAudioProcessor::HighShelf, 5000.0f, 0.707f));
     defaults.push_back (FrequalizerAudioProcessor::Band (TRANS ("Highest"),   Colours::red,    FrequalizerAudioProcessor::LowPass,  12000.0f, 0.707f));
+
+    // additional bands start as flat peaks, spread between 100 Hz and 10 kHz
+    const auto numExtra = numBands > defaults.size() ? numBands - defaults.size() : 0;
+    for (size_t i = 0; i < numExtra; ++i)
+    {
+        const auto position = float (i + 1) / float (numExtra + 1);
+        defaults.push_back (FrequalizerAudioProcessor::Band (TRANS ("Band") + " " + String (defaults.size() + 1),
+                                                             Colour::fromHSV (position, 0.6f, 0.9f, 1.0f),
+                                                             FrequalizerAudioProcessor::Peak,
+                                                             float (roundToInt (100.0f * std::pow (100.0f, position))), 1.0f));
+    }
+
+    defaults.resize (numBands, defaults.front());
     return defaults;
 }
 
-AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
+AudioProcessorValueTreeState::ParameterLayout createParameterLayout (size_t numBands)
 {
     std::vector<std::unique_ptr<AudioProcessorParameterGroup>> params;
 
     // setting defaults
     const float maxGain = Decibels::decibelsToGain (24.0f);
-    auto defaults = createDefaultBands();
+    auto defaults = createDefaultBands (numBands);
 
     {
         auto param = std::make_unique<AudioParameterFloat> (FrequalizerAudioProcessor::paramOutput, TRANS ("Output"),
@@ -78,7 +131,20 @@ AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
                                                             [](float value, int) {return String (Decibels::gainToDecibels(value), 1) + " dB";},
                                                             [](String text) {return Decibels::decibelsToGain (text.dropLastCharacters (3).getFloatValue());});
 
-        auto group = std::make_unique<AudioProcessorParameterGroup> ("global", TRANS ("Globals"), "|", std::move (param));
+        auto precision = std::make_unique<AudioParameterChoice> (FrequalizerAudioProcessor::paramPrecision, TRANS ("Precision"),
+                                                                 StringArray { TRANS ("32 bit"), TRANS ("64 bit") }, 0);
+
+        auto design = std::make_unique<AudioParameterChoice> (FrequalizerAudioProcessor::paramDesign, TRANS ("Design"),
+                                                              StringArray { TRANS ("Bilinear"), TRANS ("Analog Matched") }, 0);
+
+        auto topology = std::make_unique<AudioParameterChoice> (FrequalizerAudioProcessor::paramTopology, TRANS ("Topology"),
+                                                                StringArray { TRANS ("Biquad"), TRANS ("State Variable") }, 0);
+
+        auto engine = std::make_unique<AudioParameterChoice> (FrequalizerAudioProcessor::paramEngine, TRANS ("Engine"),
+                                                              StringArray { TRANS ("Minimum Phase"), TRANS ("Linear Phase"), TRANS ("Spectral") }, 0);
+
+        auto group = std::make_unique<AudioProcessorParameterGroup> ("global", TRANS ("Globals"), "|", std::move (param), std::move (precision),
+                                                                     std::move (design), std::move (topology), std::move (engine));
         params.push_back (std::move (group));
     }
 
@@ -130,12 +196,24 @@ AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
                                                                    [](float value, int) {return value > 0.5f ? TRANS ("active") : TRANS ("bypassed");},
                                                                    [](String text) {return text == TRANS ("active");});
 
+        auto slopeParameter = std::make_unique<AudioParameterChoice> (FrequalizerAudioProcessor::getSlopeParamName (i),
+                                                                      prefix + TRANS ("Slope"),
+                                                                      FrequalizerAudioProcessor::getSlopeNames(),
+                                                                      defaults [i].slope);
+
+        auto routingParameter = std::make_unique<AudioParameterChoice> (FrequalizerAudioProcessor::getRoutingParamName (i),
+                                                                        prefix + TRANS ("Routing"),
+                                                                        FrequalizerAudioProcessor::getRoutingNames(),
+                                                                        static_cast<int> (defaults [i].routing));
+
         auto group = std::make_unique<AudioProcessorParameterGroup> ("band" + String (i), defaults [i].name, "|",
                                                                      std::move (typeParameter),
                                                                      std::move (freqParameter),
                                                                      std::move (qltyParameter),
                                                                      std::move (gainParameter),
-                                                                     std::move (actvParameter));
+                                                                     std::move (actvParameter),
+                                                                     std::move (slopeParameter),
+                                                                     std::move (routingParameter));
 
         params.push_back (std::move (group));
     }
@@ -144,42 +222,62 @@ AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
 }
 
 //==============================================================================
-FrequalizerAudioProcessor::FrequalizerAudioProcessor() :
+FrequalizerAudioProcessor::FrequalizerAudioProcessor (size_t numBands) :
 #ifndef JucePlugin_PreferredChannelConfigurations
     AudioProcessor (BusesProperties()
                     .withInput  ("Input",  AudioChannelSet::stereo(), true)
                     .withOutput ("Output", AudioChannelSet::stereo(), true)
                     ),
 #endif
-state (*this, &undo, "PARAMS", createParameterLayout())
+state (*this, &undo, "PARAMS", createParameterLayout (numBands))
 {
-    frequencies.resize (300);
+    // the coefficient cache stores the magnitudes for exactly these frequencies
+    frequencies.resize (CoefficientCache::numMagnitudes);
     for (size_t i=0; i < frequencies.size(); ++i) {
         frequencies [i] = 20.0 * std::pow (2.0, i / 30.0);
     }
     magnitudes.resize (frequencies.size());
 
-    // needs to be in sync with the ProcessorChain filter
-    bands = createDefaultBands();
+    bands = createDefaultBands (numBands);
+    forEachFilter ([this] (auto& filter) { filter.setNumSections (bands.size() * FilterDesign::maxSections); });
+
+    // in the order of GlobalParameter, then BandParameter for each band
+    for (auto* paramID : { &paramOutput, &paramPrecision, &paramDesign, &paramTopology, &paramEngine })
+        addParameterEntry (*paramID, -1);
+
+    for (size_t i = 0; i < bands.size(); ++i)
+        for (int p = 0; p < NumBandParameters; ++p)
+            addParameterEntry (getBandParamName (i, BandParameter (p)), int (i));
+
+    outputParameter    = parameterTable [GlobalOutput].value;
+    precisionParameter = parameterTable [GlobalPrecision].value;
+    designParameter    = parameterTable [GlobalDesign].value;
+    topologyParameter  = parameterTable [GlobalTopology].value;
+    engineParameter    = parameterTable [GlobalEngine].value;
 
     for (size_t i = 0; i < bands.size(); ++i)
     {
         bands [i].magnitudes.resize (frequencies.size(), 1.0);
 
-        state.addParameterListener (getTypeParamName (i), this);
-        state.addParameterListener (getFrequencyParamName (i), this);
-        state.addParameterListener (getQualityParamName (i), this);
-        state.addParameterListener (getGainParamName (i), this);
-        state.addParameterListener (getActiveParamName (i), this);
+        SmoothedBand smoothed;
+        smoothed.typeParameter      = parameterTable [getParameterIndex (i, BandType)].value;
+        smoothed.frequencyParameter = parameterTable [getParameterIndex (i, BandFrequency)].value;
+        smoothed.qualityParameter   = parameterTable [getParameterIndex (i, BandQuality)].value;
+        smoothed.gainParameter      = parameterTable [getParameterIndex (i, BandGain)].value;
+        smoothed.slopeParameter     = parameterTable [getParameterIndex (i, BandSlope)].value;
+        smoothed.routingParameter   = parameterTable [getParameterIndex (i, BandRouting)].value;
+        smoothedBands.push_back (smoothed);
     }
 
-    state.addParameterListener (paramOutput, this);
-
     state.state = ValueTree (JucePlugin_Name);
+
+    updater.startThread();
 }
 
 FrequalizerAudioProcessor::~FrequalizerAudioProcessor()
 {
+    updater.stopThread (1000);
+    cancelPendingUpdate();
     inputAnalyser.stopThread (1000);
     outputAnalyser.stopThread (1000);
 }
@@ -215,7 +313,7 @@ bool FrequalizerAudioProcessor::isMidiEffect() const
 
 double FrequalizerAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLength;
 }
 
 int FrequalizerAudioProcessor::getNumPrograms()
@@ -245,7 +343,9 @@ void FrequalizerAudioProcessor::changeProgramName (int, const String&)
 //==============================================================================
 void FrequalizerAudioProcessor::prepareToPlay (double newSampleRate, int newSamplesPerBlock)
 {
+    ScopedLock updateLock (bandsLock);
     sampleRate = newSampleRate;
+    routingAvailable = isRoutingAvailable();
 
     dsp::ProcessSpec spec;
     spec.sampleRate = newSampleRate;
@@ -254,12 +354,51 @@ void FrequalizerAudioProcessor::prepareToPlay (double newSampleRate, int newSamp
 
     for (size_t i=0; i < bands.size(); ++i) {
         updateBand (i);
+        smoothedBands [i].readTargets (0);
     }
-    filter.get<6>().setGainLinear (*state.getRawParameterValue (paramOutput));
 
+    readOutputGain (0);
+    forEachFilter ([&] (auto& filter)
+    {
+        using NumericType = typename std::decay_t<decltype (filter)>::NumericType;
+        filter.setGainLinear (NumericType (outputGain));
+        filter.prepare (spec);
+    });
+
+    // the kernel resolves the lowest band frequencies, at any sample rate
+    const auto numChannels  = getTotalNumOutputChannels();
+    const auto kernelLength = size_t (nextPowerOfTwo (roundToInt (linearPhaseSeconds * sampleRate)));
+    linearPhaseConvolver.prepare (size_t (numChannels), kernelLength);
+    spectralEqualizer.prepare (size_t (numChannels));
+    runningEngine = EngineMinimumPhase;
+
+    kernelFrequencies.resize (kernelLength / 2 + 1);
+    kernelResponse.resize (kernelFrequencies.size());
+    for (size_t k=0; k < kernelFrequencies.size(); ++k)
+        kernelFrequencies [k] = double (k) * sampleRate / double (kernelLength);
+
+    spectralFrequencies.resize (SpectralEqualizer::numBins);
+    spectralResponse.resize (spectralFrequencies.size());
+    for (size_t k=0; k < spectralFrequencies.size(); ++k)
+        spectralFrequencies [k] = double (k) * sampleRate / double (SpectralEqualizer::frameSize);
+
+    responseBandMagnitudes.resize (jmax (kernelFrequencies.size(), spectralFrequencies.size()));
+
+    updateBypassedStates();
     updatePlots();
+    updateEngineResponse();
+    updateTailLength();
+    setLatencySamples (getCurrentLatency());
+
+    // the dry signal for the bypass crossfade, the filters run in place
+    dryFloatBuffer.setSize  (numChannels, newSamplesPerBlock);
+    dryDoubleBuffer.setSize (numChannels, newSamplesPerBlock);
+    bypassMix = 0;
 
-    filter.prepare (spec);
+    // the first block sets up whichever filter it is going to use
+    currentFilter = nullptr;
+    suspended     = false;
+    silentSamples = 0;
 
     inputAnalyser.setupAnalyser  (int (sampleRate), float (sampleRate));
     outputAnalyser.setupAnalyser (int (sampleRate), float (sampleRate));
@@ -275,31 +414,302 @@ void FrequalizerAudioProcessor::releaseResources()
 bool FrequalizerAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
     // This checks if the input layout matches the output layout
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+    const auto& mainOutput = layouts.getMainOutputChannelSet();
+    if (mainOutput != layouts.getMainInputChannelSet())
         return false;
 
-    return true;
+    // the cascade filters all channels in one pass, the routings only apply to stereo
+    return ! mainOutput.isDisabled() && mainOutput.size() <= maxNumChannels;
 }
 #endif
 
+bool FrequalizerAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
 void FrequalizerAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
 {
-    ScopedNoDenormals noDenormals;
     ignoreUnused (midiMessages);
+    processWithBypass (buffer, false);
+}
+
+void FrequalizerAudioProcessor::processBlock (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+    ignoreUnused (midiMessages);
+    processWithBypass (buffer, false);
+}
+
+void FrequalizerAudioProcessor::processBlockBypassed (AudioBuffer<float>& buffer, MidiBuffer& midiMessages)
+{
+    ignoreUnused (midiMessages);
+    processWithBypass (buffer, true);
+}
+
+void FrequalizerAudioProcessor::processBlockBypassed (AudioBuffer<double>& buffer, MidiBuffer& midiMessages)
+{
+    ignoreUnused (midiMessages);
+    processWithBypass (buffer, true);
+}
+
+template<typename IOType>
+void FrequalizerAudioProcessor::processWithBypass (AudioBuffer<IOType>& buffer, bool bypass)
+{
+    const auto engine = updateEngine();
+
+    const auto target = bypass ? 1.0 : 0.0;
+    if (bypassMix == target)
+    {
+        processSettled (buffer, bypass, engine);
+        return;
+    }
+
+    // fade in chunks that fit the dry buffer, in case the host exceeds the block size
+    auto& dry = getDryBuffer (IOType());
+    const auto numChannels = jmin (buffer.getNumChannels(), dry.getNumChannels());
+    const auto step        = 1.0 / (bypassFadeSeconds * sampleRate);
+
+    for (int start = 0; start < buffer.getNumSamples();)
+    {
+        const auto num = jmin (buffer.getNumSamples() - start, dry.getNumSamples());
+        if (num <= 0) {
+            // not prepared, nothing to fade with
+            bypassMix = target;
+            break;
+        }
+
+        AudioBuffer<IOType> chunk (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, num);
+        for (int ch = 0; ch < numChannels; ++ch)
+            dry.copyFrom (ch, 0, chunk, ch, 0, num);
+
+        // with latency the dry signal is replaced by the delayed input
+        AudioBuffer<IOType> dryChunk (dry.getArrayOfWritePointers(), numChannels, 0, num);
+        filterBuffer (chunk, &dryChunk);
+
+        auto mix = bypassMix;
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* wet = chunk.getWritePointer (ch);
+            const auto* input = dry.getReadPointer (ch);
+
+            mix = bypassMix;
+            for (int n = 0; n < num; ++n)
+            {
+                mix = bypass ? jmin (1.0, mix + step) : jmax (0.0, mix - step);
+                wet [n] += IOType (mix) * (input [n] - wet [n]);
+            }
+        }
+
+        bypassMix = numChannels > 0 ? mix : target;
+        start += num;
+
+        if (bypassMix == target)
+        {
+            // the rest of a block longer than the dry buffer goes on as if the fade was over before it
+            if (start < buffer.getNumSamples())
+            {
+                AudioBuffer<IOType> rest (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, buffer.getNumSamples() - start);
+                processSettled (rest, bypass, engine);
+            }
+            break;
+        }
+    }
+
+    // from now on the filters are skipped, they resume from rest with the current settings
+    if (bypass && bypassMix == target)
+        restartFilters();
+}
+
+template<typename IOType>
+void FrequalizerAudioProcessor::processSettled (AudioBuffer<IOType>& buffer, bool bypass, Engine engine)
+{
+    if (! bypass) {
+        filterBuffer (buffer, nullptr);
+        return;
+    }
+
+    // the dry path keeps the latency of the filtering, which only the minimum phase engine has not
+    addToAnalyser (inputAnalyser, buffer);
+
+    if (engine == EngineLinearPhase)
+        linearPhaseConvolver.delay (buffer);
+    else if (engine == EngineSpectral)
+        spectralEqualizer.delay (buffer);
+
+    addToAnalyser (outputAnalyser, buffer);
+}
+
+FrequalizerAudioProcessor::Engine FrequalizerAudioProcessor::getSelectedEngine() const
+{
+    return static_cast<Engine> (roundToInt (*engineParameter));
+}
+
+FrequalizerAudioProcessor::Engine FrequalizerAudioProcessor::updateEngine()
+{
+    // switching changes the latency, so there is nothing to crossfade with
+    const auto engine = getSelectedEngine();
+    if (engine != runningEngine)
+    {
+        runningEngine = engine;
+        if (engine == EngineLinearPhase)
+            linearPhaseConvolver.reset();
+        else if (engine == EngineSpectral)
+            spectralEqualizer.reset();
+        else
+            restartFilters();
+    }
+
+    return engine;
+}
+
+template<typename IOType>
+void FrequalizerAudioProcessor::processLinearPhase (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput)
+{
+    addToAnalyser (inputAnalyser, buffer);
+
+    linearPhaseConvolver.process (buffer, delayedInput);
+
+    addToAnalyser (outputAnalyser, buffer);
+}
+
+template<typename IOType>
+void FrequalizerAudioProcessor::processSpectral (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput)
+{
+    // the analysers get the spectra of the frames, which are there anyway
+    const auto analyse = getActiveEditor() != nullptr;
+    if (analyse)
+    {
+        const auto channels = getAnalysedChannels (buffer.getNumChannels());
+        spectralEqualizer.setAnalysedChannels (size_t (channels.getStart()), size_t (channels.getLength()));
+    }
+
+    spectralEqualizer.process (buffer, delayedInput, analyse ? &inputAnalyser : nullptr, analyse ? &outputAnalyser : nullptr);
+}
 
-    if (getActiveEditor() != nullptr)
-        inputAnalyser.addAudioData (buffer, 0, getTotalNumInputChannels());
+void FrequalizerAudioProcessor::filterBuffer (AudioBuffer<float>& buffer, AudioBuffer<float>* delayedInput)
+{
+    if (runningEngine == EngineLinearPhase) {
+        processLinearPhase (buffer, delayedInput);
+        return;
+    }
+
+    if (runningEngine == EngineSpectral) {
+        processSpectral (buffer, delayedInput);
+        return;
+    }
+
+    // 64 bit on a 32 bit host runs the filters in double and only the buffers in float
+    const auto filterInDouble = *precisionParameter >= 0.5f;
+    if (*topologyParameter >= 0.5f)
+    {
+        if (filterInDouble)
+            processBuffer (buffer, mixedSvf);
+        else
+            processBuffer (buffer, floatSvf);
+    }
+    else
+    {
+        if (filterInDouble)
+            processBuffer (buffer, mixedFilter);
+        else
+            processBuffer (buffer, floatFilter);
+    }
+}
+
+void FrequalizerAudioProcessor::filterBuffer (AudioBuffer<double>& buffer, AudioBuffer<double>* delayedInput)
+{
+    if (runningEngine == EngineLinearPhase) {
+        processLinearPhase (buffer, delayedInput);
+        return;
+    }
+
+    if (runningEngine == EngineSpectral) {
+        processSpectral (buffer, delayedInput);
+        return;
+    }
+
+    if (*topologyParameter >= 0.5f)
+        processBuffer (buffer, doubleSvf);
+    else
+        processBuffer (buffer, doubleFilter);
+}
+
+template<typename IOType, typename Cascade>
+void FrequalizerAudioProcessor::processBuffer (AudioBuffer<IOType>& buffer, Cascade& cascade)
+{
+    ScopedNoDenormals noDenormals;
+
+    addToAnalyser (inputAnalyser, buffer);
+
+    const auto numSamples  = buffer.getNumSamples();
+    const auto inputSilent = buffer.getMagnitude (0, numSamples) < IOType (silenceThreshold);
 
-    if (wasBypassed) {
-        filter.reset();
+    if (suspended)
+    {
+        // the input is below the threshold, so it is left as it is
+        if (inputSilent) {
+            addToAnalyser (outputAnalyser, buffer);
+            return;
+        }
+
+        // signal is back, nothing audible is left of the tail, so start from rest with the current settings
+        restartFilters();
+    }
+
+    if (wasBypassed || currentFilter != &cascade)
+    {
+        // switching precision or topology hands the state of the running filter over, so it doesn't click
+        const auto* previousFilter = wasBypassed ? nullptr : currentFilter;
+        startFilter (cascade);
+        forFilter (previousFilter, IOType(), [&cascade] (const auto& previous) { cascade.copyStateFrom (previous); });
         wasBypassed = false;
     }
-    dsp::AudioBlock<float>              ioBuffer (buffer);
-    dsp::ProcessContextReplacing<float> context  (ioBuffer);
-    filter.process (context);
+    dsp::AudioBlock<IOType> ioBuffer (buffer);
+    processFilters (ioBuffer, cascade);
+
+    // the tail has decayed once input and output stayed below the threshold for a while
+    if (inputSilent && buffer.getMagnitude (0, numSamples) < IOType (silenceThreshold))
+    {
+        silentSamples += numSamples;
+        suspended = silentSamples >= silenceHoldSeconds * sampleRate;
+    }
+    else
+    {
+        silentSamples = 0;
+    }
+
+    addToAnalyser (outputAnalyser, buffer);
+}
 
-    if (getActiveEditor() != nullptr)
-        outputAnalyser.addAudioData (buffer, 0, getTotalNumOutputChannels());
+void FrequalizerAudioProcessor::restartFilters()
+{
+    for (auto& band : smoothedBands)
+        band.readTargets (0);
+    readOutputGain (0);
+
+    wasBypassed   = true;
+    suspended     = false;
+    silentSamples = 0;
+}
+
+template<typename Cascade>
+void FrequalizerAudioProcessor::startFilter (Cascade& cascade)
+{
+    // the other filters didn't follow the smoothing, so start this one from the current values
+    matchedDesign = *designParameter >= 0.5f;
+    applyBypassedBands (cascade, bypassedBands.load(), true);
+    applyRoutings (cascade, true);
+    designBands<typename Cascade::Section> (true, [&cascade] (size_t i, const auto& sections)
+    {
+        for (size_t k=0; k < sections.size(); ++k)
+            cascade.setCoefficients (i * FilterDesign::maxSections + k, sections [k]);
+    });
+    cascade.setGainLinear (typename Cascade::NumericType (outputGain));
+    cascade.reset();
+    currentFilter = &cascade;
+
+    // that was this control step's design
+    samplesUntilControl = controlInterval;
 }
 
 AudioProcessorValueTreeState& FrequalizerAudioProcessor::getPluginState()
@@ -309,58 +719,227 @@ AudioProcessorValueTreeState& FrequalizerAudioProcessor::getPluginState()
 
 String FrequalizerAudioProcessor::getTypeParamName (size_t index)
 {
-    return getBandID (index) + "-" + paramType;
+    return getBandParamName (index, BandType);
 }
 
 String FrequalizerAudioProcessor::getFrequencyParamName (size_t index)
 {
-    return getBandID (index) + "-" + paramFrequency;
+    return getBandParamName (index, BandFrequency);
 }
 
 String FrequalizerAudioProcessor::getQualityParamName (size_t index)
 {
-    return getBandID (index) + "-" + paramQuality;
+    return getBandParamName (index, BandQuality);
 }
 
 String FrequalizerAudioProcessor::getGainParamName (size_t index)
 {
-    return getBandID (index) + "-" + paramGain;
+    return getBandParamName (index, BandGain);
 }
 
 String FrequalizerAudioProcessor::getActiveParamName (size_t index)
 {
-    return getBandID (index) + "-" + paramActive;
+    return getBandParamName (index, BandActive);
+}
+
+String FrequalizerAudioProcessor::getSlopeParamName (size_t index)
+{
+    return getBandParamName (index, BandSlope);
+}
+
+String FrequalizerAudioProcessor::getRoutingParamName (size_t index)
+{
+    return getBandParamName (index, BandRouting);
 }
 
 void FrequalizerAudioProcessor::parameterChanged (const String& parameter, float newValue)
 {
-    if (parameter == paramOutput) {
-        filter.get<6>().setGainLinear (newValue);
-        updatePlots();
+    // this can be called on the audio thread, so everything is left for the updater thread,
+    // the audio thread reads the new values at the next block
+    ignoreUnused (newValue);
+    const auto index = getParameterIndex (parameter);
+    if (index < 0)
+        return;
+
+    if (index == GlobalOutput) {
+        pendingPlots = true;
+        updater.notify();
         return;
     }
 
-    int index = getBandIndexFromID (parameter);
-    if (isPositiveAndBelow (index, bands.size()))
+    if (index == GlobalDesign) {
+        pendingBands = ~uint64 (0);
+        updater.notify();
+        return;
+    }
+
+    // the latency is reported from the message thread
+    if (index == GlobalEngine) {
+        pendingPlots = true;
+        updater.notify();
+        triggerAsyncUpdate();
+        return;
+    }
+
+    const auto band = parameterTable [size_t (index)].band;
+    if (isPositiveAndBelow (band, bands.size()))
     {
-        auto* band = getBand (size_t (index));
-        if (parameter.endsWith (paramType)) {
-            band->type = static_cast<FilterType> (static_cast<int> (newValue));
-        }
-        else if (parameter.endsWith (paramFrequency)) {
-            band->frequency = newValue;
-        }
-        else if (parameter.endsWith (paramQuality)) {
-            band->quality = newValue;
-        }
-        else if (parameter.endsWith (paramGain)) {
-            band->gain = newValue;
-        }
-        else if (parameter.endsWith (paramActive)) {
-            band->active = newValue >= 0.5f;
+        pendingBands |= uint64 (1) << band;
+        updater.notify();
+    }
+}
+
+void FrequalizerAudioProcessor::handlePendingUpdates()
+{
+    const auto changedBands = pendingBands.exchange (0);
+    const auto changedPlots = pendingPlots.exchange (false);
+
+    if (changedBands == 0 && ! changedPlots)
+        return;
+
+    ScopedLock updateLock (bandsLock);
+
+    for (size_t i=0; i < bands.size(); ++i)
+        if (changedBands & (uint64 (1) << i))
+            updateBand (i);
+
+    updateBypassedStates();
+    updatePlots();
+    updateEngineResponse();
+    updateTailLength();
+}
+
+void FrequalizerAudioProcessor::updateTailLength()
+{
+    if (sampleRate <= 0)
+        return;
+
+    // the bands run in series, so their decay times add up. In linear phase the kernel rings
+    // for at most its second half after the latency, the spectral engine for about a frame.
+    const auto bypassed = bypassedBands.load();
+    double seconds = 0;
+    for (size_t i=0; i < bands.size(); ++i)
+        if ((bypassed & (uint64 (1) << i)) == 0)
+            seconds += bands [i].decay;
+
+    const auto engine = getSelectedEngine();
+    if (engine == EngineLinearPhase)
+        seconds = jmin (seconds, 0.5 * double (linearPhaseConvolver.getKernelLength()) / sampleRate);
+    else if (engine == EngineSpectral)
+        seconds = jmin (seconds, double (SpectralEqualizer::frameSize) / sampleRate);
+
+    tailLength = seconds;
+
+    // hosts may do a lot of work on a display update, so only tell them about real changes
+    if (std::abs (tailLength - reportedTailLength) > 0.01 + 0.1 * reportedTailLength)
+    {
+        reportedTailLength = tailLength;
+        triggerAsyncUpdate();
+    }
+}
+
+void FrequalizerAudioProcessor::EngineResponse::resize (size_t numValues)
+{
+    for (auto& product : routings)
+        product.resize (numValues);
+
+    for (auto& entry : matrix)
+        entry.resize (numValues);
+}
+
+void FrequalizerAudioProcessor::computeResponse (const std::vector<double>& frequencyList, EngineResponse& response)
+{
+    // the same response as the plot, evaluated at the given frequencies, as a product per routing
+    const auto numValues = frequencyList.size();
+    for (auto& product : response.routings)
+        std::fill (product.begin(), product.end(), 1.0);
+
+    auto& stereo = response.routings [size_t (ChannelRouting::Stereo)];
+    std::fill (stereo.begin(), stereo.end(), double (*outputParameter));
+
+    response.isMatrix = false;
+    const auto bypassed = bypassedBands.load();
+    for (size_t i=0; i < bands.size(); ++i)
+    {
+        if ((bypassed & (uint64 (1) << i)) == 0)
+        {
+            FilterDesign::getMagnitudeForFrequencyArray (bands [i].sections, frequencyList.data(), responseBandMagnitudes.data(),
+                                                         numValues, sampleRate);
+            FloatVectorOperations::multiply (response.routings [size_t (bands [i].routing)].data(), responseBandMagnitudes.data(),
+                                             static_cast<int> (numValues));
+            response.isMatrix = response.isMatrix || bands [i].routing != ChannelRouting::Stereo;
         }
+    }
+
+    if (! response.isMatrix)
+        return;
+
+    // the cascade runs the sections on stereo, left and right first, and the ones on mid
+    // and side after them, each group commutes. So the left output gets the sum of mid and
+    // side of its own input and their difference of the other one, and vice versa.
+    const auto& left  = response.routings [size_t (ChannelRouting::Left)];
+    const auto& right = response.routings [size_t (ChannelRouting::Right)];
+    const auto& mid   = response.routings [size_t (ChannelRouting::Mid)];
+    const auto& side  = response.routings [size_t (ChannelRouting::Side)];
+
+    for (size_t k=0; k < numValues; ++k)
+    {
+        const auto fromLeft   = stereo [k] * left [k];
+        const auto fromRight  = stereo [k] * right [k];
+        const auto sum        = 0.5 * (mid [k] + side [k]);
+        const auto difference = 0.5 * (mid [k] - side [k]);
+
+        response.matrix [0][k] = sum * fromLeft;
+        response.matrix [1][k] = difference * fromRight;
+        response.matrix [2][k] = difference * fromLeft;
+        response.matrix [3][k] = sum * fromRight;
+    }
+}
+
+void FrequalizerAudioProcessor::updateEngineResponse()
+{
+    if (sampleRate <= 0)
+        return;
+
+    // both are kept up to date, so switching the engine finds the current response waiting
+    computeResponse (kernelFrequencies, kernelResponse);
+    const double* kernelMatrix[] = { kernelResponse.matrix [0].data(), kernelResponse.matrix [1].data(),
+                                     kernelResponse.matrix [2].data(), kernelResponse.matrix [3].data() };
+    linearPhaseConvolver.setKernel (kernelResponse.isMatrix ? linearPhaseConvolver.makeMatrixKernel (kernelMatrix)
+                                                            : linearPhaseConvolver.makeKernel (kernelResponse.routings [size_t (ChannelRouting::Stereo)].data()));
+
+    computeResponse (spectralFrequencies, spectralResponse);
+    const double* spectralMatrix[] = { spectralResponse.matrix [0].data(), spectralResponse.matrix [1].data(),
+                                       spectralResponse.matrix [2].data(), spectralResponse.matrix [3].data() };
+    spectralEqualizer.setGains (spectralResponse.isMatrix ? SpectralEqualizer::makeMatrixGains (spectralMatrix)
+                                                          : SpectralEqualizer::makeGains (spectralResponse.routings [size_t (ChannelRouting::Stereo)].data()));
+}
+
+int FrequalizerAudioProcessor::getCurrentLatency() const
+{
+    switch (getSelectedEngine())
+    {
+        case EngineLinearPhase: return linearPhaseConvolver.getLatencySamples();
+        case EngineSpectral:    return spectralEqualizer.getLatencySamples();
+        case EngineMinimumPhase:
+        default:                return 0;
+    }
+}
+
+void FrequalizerAudioProcessor::handleAsyncUpdate()
+{
+    if (getLatencySamples() != getCurrentLatency())
+        setLatencySamples (getCurrentLatency());
+
+    updateHostDisplay();
+}
 
-        updateBand (size_t (index));
+void FrequalizerAudioProcessor::BandUpdater::run()
+{
+    while (! threadShouldExit())
+    {
+        processor.handlePendingUpdates();
+        wait (100);
     }
 }
 
@@ -390,28 +969,59 @@ bool FrequalizerAudioProcessor::getBandSolo (int index) const
 void FrequalizerAudioProcessor::setBandSolo (int index)
 {
     soloed = index;
-    updateBypassedStates();
+    pendingPlots = true;
+    updater.notify();
 }
 
 void FrequalizerAudioProcessor::updateBypassedStates ()
 {
-    if (isPositiveAndBelow (soloed, bands.size())) {
-        filter.setBypassed<0>(soloed != 0);
-        filter.setBypassed<1>(soloed != 1);
-        filter.setBypassed<2>(soloed != 2);
-        filter.setBypassed<3>(soloed != 3);
-        filter.setBypassed<4>(soloed != 4);
-        filter.setBypassed<5>(soloed != 5);
-    }
-    else {
-        filter.setBypassed<0>(!bands[0].active);
-        filter.setBypassed<1>(!bands[1].active);
-        filter.setBypassed<2>(!bands[2].active);
-        filter.setBypassed<3>(!bands[3].active);
-        filter.setBypassed<4>(!bands[4].active);
-        filter.setBypassed<5>(!bands[5].active);
+    const auto solo = soloed.load();
+    uint64 bypassed = 0;
+    for (size_t i=0; i < bands.size(); ++i)
+        if (isPositiveAndBelow (solo, bands.size()) ? solo != int (i) : ! bands [i].active)
+            bypassed |= uint64 (1) << i;
+
+    bypassedBands = bypassed;
+}
+
+template<typename Cascade>
+void FrequalizerAudioProcessor::applyBypassedBands (Cascade& cascade, uint64 bypassed, bool allBands)
+{
+    // the cascade crossfades the bands that changed
+    for (size_t i=0; i < bands.size(); ++i)
+    {
+        const auto bit = uint64 (1) << i;
+        if (allBands || ((bypassed ^ appliedBypass) & bit) != 0)
+            for (size_t k=0; k < FilterDesign::maxSections; ++k)
+                cascade.setBypassed (i * FilterDesign::maxSections + k, (bypassed & bit) != 0);
     }
-    updatePlots();
+
+    appliedBypass = bypassed;
+}
+
+template<typename Cascade>
+void FrequalizerAudioProcessor::applyRoutings (Cascade& cascade, bool allBands)
+{
+    // the cascade fades a band out and in again on its new channels
+    for (size_t i=0; i < smoothedBands.size(); ++i)
+    {
+        auto& band = smoothedBands [i];
+        const auto routing = getBandRouting (*band.routingParameter);
+        if (allBands || routing != band.routing)
+        {
+            band.routing = routing;
+            for (size_t k=0; k < FilterDesign::maxSections; ++k)
+                cascade.setRouting (i * FilterDesign::maxSections + k, routing);
+        }
+    }
+}
+
+ChannelRouting FrequalizerAudioProcessor::getBandRouting (float parameterValue) const
+{
+    if (! routingAvailable)
+        return ChannelRouting::Stereo;
+
+    return static_cast<ChannelRouting> (roundToInt (parameterValue));
 }
 
 FrequalizerAudioProcessor::Band* FrequalizerAudioProcessor::getBand (size_t index)
@@ -439,93 +1049,473 @@ StringArray FrequalizerAudioProcessor::getFilterTypeNames()
     };
 }
 
+StringArray FrequalizerAudioProcessor::getSlopeNames()
+{
+    return {
+        TRANS ("12 dB/oct"),
+        TRANS ("24 dB/oct"),
+        TRANS ("36 dB/oct"),
+        TRANS ("48 dB/oct"),
+        TRANS ("96 dB/oct"),
+        TRANS ("12 dB/oct LR"),
+        TRANS ("24 dB/oct LR"),
+        TRANS ("36 dB/oct LR"),
+        TRANS ("48 dB/oct LR"),
+        TRANS ("96 dB/oct LR")
+    };
+}
+
+StringArray FrequalizerAudioProcessor::getRoutingNames()
+{
+    return {
+        TRANS ("Stereo"),
+        TRANS ("Left"),
+        TRANS ("Right"),
+        TRANS ("Mid"),
+        TRANS ("Side")
+    };
+}
+
+bool FrequalizerAudioProcessor::isRoutingAvailable() const
+{
+    // surround pairs like C and LFE, or ambisonic components, have no left and right
+    const auto* output = getBus (false, 0);
+    return output != nullptr && output->getCurrentLayout() == AudioChannelSet::stereo();
+}
+
+//==============================================================================
+namespace
+{
+    using Processor = FrequalizerAudioProcessor;
+
+    /** The design of a single section of each filter type, for either topology.
+        Types without a specialisation are identity. */
+    template<Processor::FilterType type>
+    struct SectionDesign
+    {
+        template<typename Section>
+        static void design (Section& c, bool, double, double, double, double) { c = {}; }
+    };
+
+    template<>
+    struct SectionDesign<Processor::LowPass>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeLowPass<Type> (sampleRate, frequency, quality); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeSvfLowPass<Type> (sampleRate, frequency, quality); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::LowPass1st>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double, double)
+        { c = FilterDesign::makeFirstOrderLowPass<Type> (sampleRate, frequency); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double, double)
+        { c = FilterDesign::makeSvfFirstOrderLowPass<Type> (sampleRate, frequency); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::LowShelf>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool matched, double sampleRate, double frequency, double quality, double gain)
+        {
+            c = matched ? FilterDesign::makeMatchedLowShelf<Type> (sampleRate, frequency, quality, gain)
+                        : FilterDesign::makeLowShelf<Type> (sampleRate, frequency, quality, gain);
+        }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool matched, double sampleRate, double frequency, double quality, double gain)
+        {
+            c = matched ? FilterDesign::toSvf<Type> (FilterDesign::makeMatchedLowShelf<double> (sampleRate, frequency, quality, gain))
+                        : FilterDesign::makeSvfLowShelf<Type> (sampleRate, frequency, quality, gain);
+        }
+    };
+
+    template<>
+    struct SectionDesign<Processor::BandPass>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeBandPass<Type> (sampleRate, frequency, quality); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeSvfBandPass<Type> (sampleRate, frequency, quality); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::AllPass>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeAllPass<Type> (sampleRate, frequency, quality); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeSvfAllPass<Type> (sampleRate, frequency, quality); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::AllPass1st>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double, double)
+        { c = FilterDesign::makeFirstOrderAllPass<Type> (sampleRate, frequency); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double, double)
+        { c = FilterDesign::makeSvfFirstOrderAllPass<Type> (sampleRate, frequency); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::Notch>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeNotch<Type> (sampleRate, frequency, quality); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeSvfNotch<Type> (sampleRate, frequency, quality); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::Peak>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool matched, double sampleRate, double frequency, double quality, double gain)
+        {
+            c = matched ? FilterDesign::makeMatchedPeakFilter<Type> (sampleRate, frequency, quality, gain)
+                        : FilterDesign::makePeakFilter<Type> (sampleRate, frequency, quality, gain);
+        }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool matched, double sampleRate, double frequency, double quality, double gain)
+        {
+            c = matched ? FilterDesign::toSvf<Type> (FilterDesign::makeMatchedPeakFilter<double> (sampleRate, frequency, quality, gain))
+                        : FilterDesign::makeSvfPeakFilter<Type> (sampleRate, frequency, quality, gain);
+        }
+    };
+
+    template<>
+    struct SectionDesign<Processor::HighShelf>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool matched, double sampleRate, double frequency, double quality, double gain)
+        {
+            c = matched ? FilterDesign::makeMatchedHighShelf<Type> (sampleRate, frequency, quality, gain)
+                        : FilterDesign::makeHighShelf<Type> (sampleRate, frequency, quality, gain);
+        }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool matched, double sampleRate, double frequency, double quality, double gain)
+        {
+            c = matched ? FilterDesign::toSvf<Type> (FilterDesign::makeMatchedHighShelf<double> (sampleRate, frequency, quality, gain))
+                        : FilterDesign::makeSvfHighShelf<Type> (sampleRate, frequency, quality, gain);
+        }
+    };
+
+    template<>
+    struct SectionDesign<Processor::HighPass1st>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double, double)
+        { c = FilterDesign::makeFirstOrderHighPass<Type> (sampleRate, frequency); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double, double)
+        { c = FilterDesign::makeSvfFirstOrderHighPass<Type> (sampleRate, frequency); }
+    };
+
+    template<>
+    struct SectionDesign<Processor::HighPass>
+    {
+        template<typename Type>
+        static void design (FilterDesign::Biquad<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeHighPass<Type> (sampleRate, frequency, quality); }
+
+        template<typename Type>
+        static void design (FilterDesign::Svf<Type>& c, bool, double sampleRate, double frequency, double quality, double)
+        { c = FilterDesign::makeSvfHighPass<Type> (sampleRate, frequency, quality); }
+    };
+
+    template<typename Section>
+    using SectionDesignFunction = void (*) (Section&, bool, double, double, double, double);
+
+    template<typename Section, size_t... types>
+    constexpr std::array<SectionDesignFunction<Section>, sizeof... (types)> makeSectionDesigns (std::index_sequence<types...>)
+    {
+        return {{ &SectionDesign<Processor::FilterType (types)>::design... }};
+    }
+
+    /** Designs one section through a table of the specialised designs, built at compile time. */
+    template<typename Section>
+    void designSection (Section& section, Processor::FilterType type, bool matched, double sampleRate, double frequency, double quality, double gain)
+    {
+        static constexpr auto designs = makeSectionDesigns<Section> (std::make_index_sequence<size_t (Processor::LastFilterID)>());
+
+        // a peak or shelf without gain is identity, so the cascade can drop it
+        const auto hasGain = type == Processor::LowShelf || type == Processor::Peak || type == Processor::HighShelf;
+        if (! isPositiveAndBelow (int (type), int (designs.size())) || (hasGain && std::abs (gain - 1.0) < 1.0e-5))
+        {
+            section = {};
+            return;
+        }
+
+        designs [size_t (type)] (section, matched, sampleRate, frequency, quality, gain);
+    }
+}
+
+template<typename Type>
+void FrequalizerAudioProcessor::designBand (FilterDesign::Sections<FilterDesign::Biquad<Type>>& sections, FilterType type, int slope, bool matched,
+                                            double sampleRate, double frequency, double quality, double gain)
+{
+    // keep the bilinear transform away from Nyquist, so low sample rates stay stable
+    frequency = jmin (frequency, 0.49 * sampleRate);
+
+    if (type == LowPass || type == HighPass)
+    {
+        // the first half of the slopes are Butterworth, the second half Linkwitz-Riley
+        const int orders[] = { 2, 4, 6, 8, 16 };
+        const auto numOrders = numElementsInArray (orders);
+        const auto order = orders [jlimit (0, numOrders - 1, slope % numOrders)];
+
+        if (slope >= numOrders)
+            sections = FilterDesign::makeLinkwitzRiley<Type> (type == HighPass, order, sampleRate, frequency);
+        else
+            sections = FilterDesign::makeButterworth<Type> (type == HighPass, order, sampleRate, frequency, quality);
+        return;
+    }
+
+    sections.fill ({});
+    designSection (sections [0], type, matched, sampleRate, frequency, quality, gain);
+}
+
+template<typename Type>
+void FrequalizerAudioProcessor::designBand (FilterDesign::Sections<FilterDesign::Svf<Type>>& sections, FilterType type, int slope, bool matched,
+                                            double sampleRate, double frequency, double quality, double gain)
+{
+    if (type == LowPass || type == HighPass)
+    {
+        // the steep slopes have no direct form, so convert their biquads
+        FilterDesign::Sections<FilterDesign::Biquad<double>> biquads;
+        designBand (biquads, type, slope, matched, sampleRate, frequency, quality, gain);
+        for (size_t k=0; k < sections.size(); ++k)
+            sections [k] = FilterDesign::toSvf<Type> (biquads [k]);
+        return;
+    }
+
+    sections.fill ({});
+    designSection (sections [0], type, matched, sampleRate, jmin (frequency, 0.49 * sampleRate), quality, gain);
+}
+
 void FrequalizerAudioProcessor::updateBand (const size_t index)
 {
+    auto& band = bands [index];
+    band.type      = static_cast<FilterType> (static_cast<int> (getBandValue (index, BandType)));
+    band.frequency = getBandValue (index, BandFrequency);
+    band.quality   = getBandValue (index, BandQuality);
+    band.gain      = getBandValue (index, BandGain);
+    band.active    = getBandValue (index, BandActive) >= 0.5f;
+    band.slope     = static_cast<int> (getBandValue (index, BandSlope));
+    band.routing   = getBandRouting (getBandValue (index, BandRouting));
+
     if (sampleRate > 0) {
-        dsp::IIR::Coefficients<float>::Ptr newCoefficients;
-        switch (bands [index].type) {
-            case NoFilter:
-                newCoefficients = new dsp::IIR::Coefficients<float> (1, 0, 1, 0);
-                break;
-            case LowPass:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeLowPass (sampleRate, bands [index].frequency, bands [index].quality);
-                break;
-            case LowPass1st:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeFirstOrderLowPass (sampleRate, bands [index].frequency);
-                break;
-            case LowShelf:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeLowShelf (sampleRate, bands [index].frequency, bands [index].quality, bands [index].gain);
-                break;
-            case BandPass:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeBandPass (sampleRate, bands [index].frequency, bands [index].quality);
-                break;
-            case AllPass:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeAllPass (sampleRate, bands [index].frequency, bands [index].quality);
-                break;
-            case AllPass1st:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeFirstOrderAllPass (sampleRate, bands [index].frequency);
-                break;
-            case Notch:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeNotch (sampleRate, bands [index].frequency, bands [index].quality);
-                break;
-            case Peak:
-                newCoefficients = dsp::IIR::Coefficients<float>::makePeakFilter (sampleRate, bands [index].frequency, bands [index].quality, bands [index].gain);
-                break;
-            case HighShelf:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeHighShelf (sampleRate, bands [index].frequency, bands [index].quality, bands [index].gain);
-                break;
-            case HighPass1st:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeFirstOrderHighPass (sampleRate, bands [index].frequency);
-                break;
-            case HighPass:
-                newCoefficients = dsp::IIR::Coefficients<float>::makeHighPass (sampleRate, bands [index].frequency, bands [index].quality);
-                break;
-            default:
-                break;
+        // the audio thread designs its own coefficients, these are only for the plots.
+        // Both topologies have the same response, so the plot is designed as biquads.
+        const auto matched = *designParameter >= 0.5f;
+        const auto key = CoefficientCache::makeKey (band.type, band.slope, matched, sampleRate, band.frequency, band.quality, band.gain);
+
+        CoefficientCache::Entry entry;
+        if (! coefficientCache->lookup (key, entry))
+        {
+            designBand (entry.sections, band.type, band.slope, matched, sampleRate, key.getFrequency(), key.getQuality(), key.getGain());
+            FilterDesign::getMagnitudeForFrequencyArray (entry.sections,
+                                                         frequencies.data(),
+                                                         entry.magnitudes.data(),
+                                                         frequencies.size(), sampleRate);
+            coefficientCache->store (key, entry);
         }
 
-        if (newCoefficients)
+        std::copy (entry.magnitudes.begin(), entry.magnitudes.end(), band.magnitudes.begin());
+        band.sections = entry.sections;
+        band.decay = FilterDesign::getDecaySeconds (entry.sections, sampleRate, silenceThreshold);
+    }
+}
+
+//==============================================================================
+void FrequalizerAudioProcessor::SmoothedBand::readTargets (int numSteps)
+{
+    const auto newType  = static_cast<FilterType> (static_cast<int> (*typeParameter));
+    const auto newSlope = static_cast<int> (*slopeParameter);
+    if (newType != type || newSlope != slope)
+    {
+        type  = newType;
+        slope = newSlope;
+        changed = true;
+    }
+
+    const double newTargets[] = { std::log2 (double (*frequencyParameter)),
+                                  std::log2 (jmax (1.0e-5, double (*gainParameter))),
+                                  std::log2 (double (*qualityParameter)) };
+
+    if (numSteps > 0 && std::equal (std::begin (newTargets), std::end (newTargets), std::begin (targets)))
+        return;
+
+    for (size_t i=0; i < numValues; ++i)
+    {
+        targets [i] = newTargets [i];
+        if (numSteps > 0)
+            steps [i] = (targets [i] - values [i]) / numSteps;
+        else
+            values [i] = targets [i];
+    }
+
+    stepsLeft = numSteps;
+    changed = true;
+}
+
+bool FrequalizerAudioProcessor::SmoothedBand::advance()
+{
+    if (stepsLeft > 0)
+    {
+        if (--stepsLeft == 0)
+            std::copy (std::begin (targets), std::end (targets), std::begin (values));
+        else
+            for (size_t i=0; i < numValues; ++i)
+                values [i] += steps [i];
+
+        changed = true;
+    }
+
+    return std::exchange (changed, false);
+}
+
+void FrequalizerAudioProcessor::readOutputGain (int numSteps)
+{
+    const auto target = double (*outputParameter);
+    if (numSteps > 0 && target == outputTarget)
+        return;
+
+    outputTarget = target;
+    if (numSteps > 0)
+    {
+        outputStep      = (outputTarget - outputGain) / numSteps;
+        outputStepsLeft = numSteps;
+    }
+    else
+    {
+        outputGain      = outputTarget;
+        outputStepsLeft = 0;
+    }
+}
+
+template<typename Section, typename Function>
+void FrequalizerAudioProcessor::designBands (bool allBands, Function&& useSections)
+{
+    const auto numValues = SmoothedBand::numValues;
+    size_t numChanged = 0;
+
+    for (size_t i=0; i < smoothedBands.size(); ++i)
+    {
+        if (smoothedBands [i].advance() || allBands)
+        {
+            const auto& values = smoothedBands [i].values;
+            std::copy (std::begin (values), std::end (values), designedValues.data() + numValues * numChanged);
+            designedBands [numChanged++] = i;
+        }
+    }
+
+    // back from log2 for all changed bands at once
+    FastMath::exp2 (designedValues.data(), designedValues.data(), numValues * numChanged);
+
+    FilterDesign::Sections<Section> sections;
+    for (size_t j=0; j < numChanged; ++j)
+    {
+        const auto  i      = designedBands [j];
+        const auto* linear = designedValues.data() + numValues * j;
+        designBand (sections, smoothedBands [i].type, smoothedBands [i].slope, matchedDesign, sampleRate, linear [0], linear [2], linear [1]);
+        useSections (i, sections);
+    }
+}
+
+template<typename IOType, typename Cascade>
+void FrequalizerAudioProcessor::processFilters (dsp::AudioBlock<IOType>& block, Cascade& cascade)
+{
+    // the wrappers deliver one value per parameter and block, which the host meant for its end.
+    // So a block longer than the smoothing spreads the change over all of it, which follows the
+    // automation instead of jumping at the start and holding the value for the rest of the block.
+    const auto numSamples        = block.getNumSamples();
+    const auto smoothingSamples  = jmax (smoothingSeconds * sampleRate, double (numSamples));
+    const auto numSmoothingSteps = int (std::ceil (smoothingSamples / controlInterval));
+    for (auto& band : smoothedBands)
+        band.readTargets (numSmoothingSteps);
+    readOutputGain (numSmoothingSteps);
+
+    const auto bypassed = bypassedBands.load();
+    if (bypassed != appliedBypass)
+        applyBypassedBands (cascade, bypassed, false);
+
+    applyRoutings (cascade, false);
+
+    const auto matched = *designParameter >= 0.5f;
+    if (matched != matchedDesign)
+    {
+        matchedDesign = matched;
+        for (auto& band : smoothedBands)
+            band.changed = true;
+    }
+
+    // design at control rate and let the cascade interpolate linearly in between. The sub-blocks
+    // end at the control steps, wherever they fall in the host's block, and a ramp that starts
+    // near the end of one block goes on in the next, so it always spans the whole step.
+    for (size_t start = 0; start < numSamples;)
+    {
+        if (samplesUntilControl == 0)
         {
+            designBands<typename Cascade::Section> (false, [&cascade] (size_t i, const auto& sections)
+            {
+                for (size_t k=0; k < sections.size(); ++k)
+                    cascade.setTargetCoefficients (i * FilterDesign::maxSections + k, sections [k]);
+            });
+
+            if (outputStepsLeft > 0)
             {
-                // minimise lock scope, get<0>() needs to be a  compile time constant
-                ScopedLock processLock (getCallbackLock());
-                if (index == 0)
-                    *filter.get<0>().state = *newCoefficients;
-                else if (index == 1)
-                    *filter.get<1>().state = *newCoefficients;
-                else if (index == 2)
-                    *filter.get<2>().state = *newCoefficients;
-                else if (index == 3)
-                    *filter.get<3>().state = *newCoefficients;
-                else if (index == 4)
-                    *filter.get<4>().state = *newCoefficients;
-                else if (index == 5)
-                    *filter.get<5>().state = *newCoefficients;
+                outputGain = --outputStepsLeft == 0 ? outputTarget : outputGain + outputStep;
+                cascade.setTargetGainLinear (typename Cascade::NumericType (outputGain));
             }
-            newCoefficients->getMagnitudeForFrequencyArray (frequencies.data(),
-                                                            bands [index].magnitudes.data(),
-                                                            frequencies.size(), sampleRate);
 
+            samplesUntilControl = controlInterval;
         }
-        updateBypassedStates();
-        updatePlots();
+
+        const auto num = jmin (samplesUntilControl, numSamples - start);
+
+        auto subBlock = block.getSubBlock (start, num);
+        dsp::ProcessContextReplacing<IOType> context (subBlock);
+        cascade.process (context, samplesUntilControl);
+
+        samplesUntilControl -= num;
+        start += num;
     }
 }
 
 void FrequalizerAudioProcessor::updatePlots ()
 {
-    auto gain = filter.get<6>().getGainLinear();
+    auto gain = *outputParameter;
     std::fill (magnitudes.begin(), magnitudes.end(), gain);
 
-    if (isPositiveAndBelow (soloed, bands.size())) {
-        FloatVectorOperations::multiply (magnitudes.data(), bands [size_t (soloed)].magnitudes.data(), static_cast<int> (magnitudes.size()));
-    }
-    else
-    {
-        for (size_t i=0; i < bands.size(); ++i)
-            if (bands[i].active)
-                FloatVectorOperations::multiply (magnitudes.data(), bands [i].magnitudes.data(), static_cast<int> (magnitudes.size()));
-    }
+    const auto bypassed = bypassedBands.load();
+    for (size_t i=0; i < bands.size(); ++i)
+        if ((bypassed & (uint64 (1) << i)) == 0)
+            FloatVectorOperations::multiply (magnitudes.data(), bands [i].magnitudes.data(), static_cast<int> (magnitudes.size()));
 
     sendChangeMessage();
 }
@@ -548,6 +1538,7 @@ const std::vector<double>& FrequalizerAudioProcessor::getMagnitudes ()
 
 void FrequalizerAudioProcessor::createFrequencyPlot (Path& p, const std::vector<double>& mags, const Rectangle<int> bounds, float pixelsPerDouble)
 {
+    ScopedLock updateLock (bandsLock);
     p.startNewSubPath (bounds.getX(), mags [0] > 0 ? float (bounds.getCentreY() - pixelsPerDouble * std::log (mags [0]) / std::log (2)) : bounds.getBottom());
     const double xFactor = static_cast<double> (bounds.getWidth()) / frequencies.size();
     for (size_t i=1; i < frequencies.size(); ++i)
@@ -570,12 +1561,72 @@ bool FrequalizerAudioProcessor::checkForNewAnalyserData()
     return inputAnalyser.checkForNewData() || outputAnalyser.checkForNewData();
 }
 
+StringArray FrequalizerAudioProcessor::getAnalyserTapNames() const
+{
+    StringArray names { TRANS ("All Channels") };
+
+    const auto* output = getBus (false, 0);
+    if (output == nullptr)
+        return names;
+
+    // pairs of the layout's channels, discrete ones go by number
+    const auto layout = output->getCurrentLayout();
+    auto getChannelName = [&layout] (int channel)
+    {
+        const auto name = AudioChannelSet::getAbbreviatedChannelTypeName (layout.getTypeOfChannel (channel));
+        return name.isNotEmpty() ? name : String (channel + 1);
+    };
+
+    for (int channel = 0; channel < layout.size(); channel += 2)
+    {
+        if (channel + 1 < layout.size())
+            names.add (getChannelName (channel) + " + " + getChannelName (channel + 1));
+        else
+            names.add (getChannelName (channel));
+    }
+
+    return names;
+}
+
+void FrequalizerAudioProcessor::setAnalyserTap (int pair)
+{
+    analyserTap = pair;
+}
+
+int FrequalizerAudioProcessor::getAnalyserTap() const
+{
+    return analyserTap;
+}
+
+Range<int> FrequalizerAudioProcessor::getAnalysedChannels (int numChannels) const
+{
+    numChannels = jmin (numChannels, getTotalNumOutputChannels());
+
+    const auto pair = analyserTap.load();
+    if (pair < 0 || 2 * pair >= numChannels)
+        return { 0, numChannels };
+
+    return { 2 * pair, jmin (2 * pair + 2, numChannels) };
+}
+
+template<typename IOType>
+void FrequalizerAudioProcessor::addToAnalyser (Analyser<float>& analyser, const AudioBuffer<IOType>& buffer)
+{
+    if (getActiveEditor() == nullptr)
+        return;
+
+    const auto channels = getAnalysedChannels (buffer.getNumChannels());
+    if (! channels.isEmpty())
+        analyser.addAudioData (buffer, channels.getStart(), channels.getLength());
+}
+
 //==============================================================================
 void FrequalizerAudioProcessor::getStateInformation (MemoryBlock& destData)
 {
     auto editor = state.state.getOrCreateChildWithName (IDs::editor, nullptr);
     editor.setProperty (IDs::sizeX, editorSize.x, nullptr);
     editor.setProperty (IDs::sizeY, editorSize.y, nullptr);
+    editor.setProperty (IDs::tap,   analyserTap.load(), nullptr);
 
     MemoryOutputStream stream(destData, false);
     state.state.writeToStream (stream);
@@ -592,6 +1643,7 @@ void FrequalizerAudioProcessor::setStateInformation (const void* data, int sizeI
         {
             editorSize.setX (editor.getProperty (IDs::sizeX, 900));
             editorSize.setY (editor.getProperty (IDs::sizeY, 500));
+            analyserTap = editor.getProperty (IDs::tap, -1);
             if (auto* activeEditor = getActiveEditor())
                 activeEditor->setSize (editorSize.x, editorSize.y);
         }
@@ -8,15 +8,25 @@
 
 #pragma once
 
-#include "../JuceLibraryCode/JuceHeader.h"
-
+#include <JuceHeader.h>
+#include "FilterDesign.h"
+#include "FilterCascade.h"
+#include "CoefficientCache.h"
+#include "LinearPhaseConvolver.h"
+#include "SpectralEqualizer.h"
+
+/** The number of bands a new instance gets, up to FrequalizerAudioProcessor::maxNumBands */
+#ifndef FREQUALIZER_NUM_BANDS
+ #define FREQUALIZER_NUM_BANDS 6
+#endif
 
 //==============================================================================
 /**
 */
 class FrequalizerAudioProcessor  : public AudioProcessor,
                                    public AudioProcessorValueTreeState::Listener,
-                                   public ChangeBroadcaster
+                                   public ChangeBroadcaster,
+                                   private AsyncUpdater
 {
 public:
     enum FilterType
@@ -36,22 +46,49 @@ public:
         LastFilterID
     };
 
+    static constexpr size_t maxNumBands = 32;
+
+    /** Up to 7.1.4 and third order ambisonics, with the same layout in and out */
+    static constexpr int maxNumChannels = 16;
+
+    /** The parameters each band has, to look them up by index instead of by ID */
+    enum BandParameter
+    {
+        BandType = 0,
+        BandFrequency,
+        BandQuality,
+        BandGain,
+        BandActive,
+        BandSlope,
+        BandRouting,
+        NumBandParameters
+    };
+
     static String paramOutput;
+    static String paramPrecision;
+    static String paramDesign;
+    static String paramTopology;
+    static String paramEngine;
     static String paramType;
     static String paramFrequency;
     static String paramQuality;
     static String paramGain;
     static String paramActive;
+    static String paramSlope;
+    static String paramRouting;
 
     static String getBandID (size_t index);
+    static String getBandParamName (size_t index, BandParameter parameter);
     static String getTypeParamName (size_t index);
     static String getFrequencyParamName (size_t index);
     static String getQualityParamName (size_t index);
     static String getGainParamName (size_t index);
     static String getActiveParamName (size_t index);
+    static String getSlopeParamName (size_t index);
+    static String getRoutingParamName (size_t index);
 
     //==============================================================================
-    FrequalizerAudioProcessor();
+    explicit FrequalizerAudioProcessor (size_t numBands = FREQUALIZER_NUM_BANDS);
     ~FrequalizerAudioProcessor();
 
     //==============================================================================
@@ -62,7 +99,14 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
    #endif
 
+    bool supportsDoublePrecisionProcessing() const override;
+
     void processBlock (AudioBuffer<float>&, MidiBuffer&) override;
+    void processBlock (AudioBuffer<double>&, MidiBuffer&) override;
+
+    /** Fades to the dry signal, then leaves the buffer alone until processing resumes. */
+    void processBlockBypassed (AudioBuffer<float>&, MidiBuffer&) override;
+    void processBlockBypassed (AudioBuffer<double>&, MidiBuffer&) override;
 
     void parameterChanged (const String& parameter, float newValue) override;
 
@@ -78,6 +122,16 @@ public:
 
     static StringArray getFilterTypeNames();
 
+    /** The slopes of the high and low pass, 12 to 96 dB/oct in Butterworth and Linkwitz-Riley */
+    static StringArray getSlopeNames();
+
+    /** The channels a band can filter, in the order of ChannelRouting */
+    static StringArray getRoutingNames();
+
+    /** Left, right, mid and side only mean something on a stereo layout, on any other
+        layout all bands filter all channels. */
+    bool isRoutingAvailable() const;
+
     //==============================================================================
     AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -90,6 +144,12 @@ public:
 
     bool checkForNewAnalyserData();
 
+    /** The analysers show the sum of all channels, or of one pair of the output layout,
+        named after its channels */
+    StringArray getAnalyserTapNames() const;
+    void setAnalyserTap (int pair);
+    int  getAnalyserTap() const;
+
     //==============================================================================
     const String getName() const override;
 
@@ -131,42 +191,330 @@ public:
         float       quality   = 1.0f;
         float       gain      = 1.0f;
         bool        active    = true;
+        int         slope     = 0;
+        ChannelRouting routing = ChannelRouting::Stereo;
+        double      decay     = 0;    // seconds for the impulse response to fall below the silence threshold
+        FilterDesign::Sections<FilterDesign::Biquad<double>> sections;
         std::vector<double> magnitudes;
     };
 
     Band* getBand (size_t index);
-    int getBandIndexFromID (String paramID);
+    int getBandIndexFromID (const String& paramID) const;
+
+    /** Returns the parameter of a band from the table, without building its ID */
+    AudioProcessorParameter* getBandParameter (size_t index, BandParameter parameter) const;
 
 private:
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FrequalizerAudioProcessor)
 
+    void handlePendingUpdates();
+
     void updateBand (const size_t index);
 
+    template<typename Type>
+    static void designBand (FilterDesign::Sections<FilterDesign::Biquad<Type>>& sections, FilterType type, int slope, bool matched,
+                            double sampleRate, double frequency, double quality, double gain);
+
+    template<typename Type>
+    static void designBand (FilterDesign::Sections<FilterDesign::Svf<Type>>& sections, FilterType type, int slope, bool matched,
+                            double sampleRate, double frequency, double quality, double gain);
+
+    template<typename IOType>
+    void processWithBypass (AudioBuffer<IOType>& buffer, bool bypass);
+
+    void filterBuffer (AudioBuffer<float>& buffer, AudioBuffer<float>* delayedInput);
+    void filterBuffer (AudioBuffer<double>& buffer, AudioBuffer<double>* delayedInput);
+
+    /** The engines the bands can run in, selected with paramEngine. */
+    enum Engine
+    {
+        EngineMinimumPhase = 0,
+        EngineLinearPhase,
+        EngineSpectral
+    };
+
+    Engine getSelectedEngine() const;
+    Engine updateEngine();
+
+    /** Filters the buffer, or only delays it while bypassed, once the bypass fade is over. */
+    template<typename IOType>
+    void processSettled (AudioBuffer<IOType>& buffer, bool bypass, Engine engine);
+
+    template<typename IOType>
+    void processLinearPhase (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput);
+
+    template<typename IOType>
+    void processSpectral (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput);
+
+    /** The magnitudes of the bands on each routing, and the stereo matrix they make up
+        when any band is routed to some of the channels. */
+    struct EngineResponse
+    {
+        void resize (size_t numValues);
+
+        std::array<std::vector<double>, size_t (ChannelRouting::Side) + 1> routings;
+        std::array<std::vector<double>, LinearPhaseConvolver::numMatrixResponses> matrix;
+        bool isMatrix = false;
+    };
+
+    void computeResponse (const std::vector<double>& frequencyList, EngineResponse& response);
+    void updateEngineResponse();
+
+    int getCurrentLatency() const;
+
+    template<typename IOType, typename Cascade>
+    void processBuffer (AudioBuffer<IOType>& buffer, Cascade& cascade);
+
+    /** The channels of the tapped pair, or all of them. */
+    Range<int> getAnalysedChannels (int numChannels) const;
+
+    template<typename IOType>
+    void addToAnalyser (Analyser<float>& analyser, const AudioBuffer<IOType>& buffer);
+
+    void restartFilters();
+
+    AudioBuffer<float>&  getDryBuffer (float)   { return dryFloatBuffer; }
+    AudioBuffer<double>& getDryBuffer (double)  { return dryDoubleBuffer; }
+
+    template<typename Cascade>
+    void startFilter (Cascade& cascade);
+
+    template<typename Cascade>
+    void applyBypassedBands (Cascade& cascade, uint64 bypassed, bool allBands);
+
+    template<typename Cascade>
+    void applyRoutings (Cascade& cascade, bool allBands);
+
+    ChannelRouting getBandRouting (float parameterValue) const;
+
+    template<typename Section, typename Function>
+    void designBands (bool allBands, Function&& useSections);
+
+    template<typename IOType, typename Cascade>
+    void processFilters (dsp::AudioBlock<IOType>& block, Cascade& cascade);
+
+    template<typename Function>
+    void forEachFilter (Function&& function)
+    {
+        function (floatFilter);
+        function (mixedFilter);
+        function (doubleFilter);
+        function (floatSvf);
+        function (mixedSvf);
+        function (doubleSvf);
+    }
+
+    /** Calls the function with the filter the pointer refers to, if it runs on these buffers. */
+    template<typename Function>
+    void forFilter (const void* filter, float, Function&& function)
+    {
+        if      (filter == &floatFilter)  function (floatFilter);
+        else if (filter == &mixedFilter)  function (mixedFilter);
+        else if (filter == &floatSvf)     function (floatSvf);
+        else if (filter == &mixedSvf)     function (mixedSvf);
+    }
+
+    template<typename Function>
+    void forFilter (const void* filter, double, Function&& function)
+    {
+        if      (filter == &doubleFilter) function (doubleFilter);
+        else if (filter == &doubleSvf)    function (doubleSvf);
+    }
+
     void updateBypassedStates ();
 
     void updatePlots ();
 
+    void updateTailLength ();
+
+    void readOutputGain (int numSteps);
+
+    void handleAsyncUpdate() override;
+
     UndoManager                  undo;
     AudioProcessorValueTreeState state;
 
+    //==============================================================================
+    /** Every parameter ID is interned once at construction. It maps to an index into the
+        table, which caches the parameter and its raw value, so parameterChanged only hashes
+        the ID and nothing else has to build or compare strings. The global parameters come
+        first, then NumBandParameters for each band. */
+    enum GlobalParameter
+    {
+        GlobalOutput = 0,
+        GlobalPrecision,
+        GlobalDesign,
+        GlobalTopology,
+        GlobalEngine,
+        NumGlobalParameters
+    };
+
+    struct ParameterEntry
+    {
+        AudioProcessorParameter* parameter = nullptr;
+        float*                   value     = nullptr;
+        int                      band      = -1;     // -1 for the global parameters
+    };
+
+    void addParameterEntry (const String& paramID, int band);
+
+    int getParameterIndex (const String& paramID) const;
+
+    static size_t getParameterIndex (size_t band, BandParameter parameter)
+    {
+        return NumGlobalParameters + band * NumBandParameters + size_t (parameter);
+    }
+
+    float getBandValue (size_t band, BandParameter parameter) const
+    {
+        return *parameterTable [getParameterIndex (band, parameter)].value;
+    }
+
+    std::vector<ParameterEntry> parameterTable;
+    HashMap<String, int>        parameterIndices;
+
     std::vector<Band>    bands;
 
     std::vector<double> frequencies;
     std::vector<double> magnitudes;
 
+    // the plot designs, shared by all instances
+    SharedResourcePointer<CoefficientCache> coefficientCache;
+
     bool wasBypassed = true;
 
-    using FilterBand = dsp::ProcessorDuplicator<dsp::IIR::Filter<float>, dsp::IIR::Coefficients<float>>;
-    using Gain       = dsp::Gain<float>;
-    dsp::ProcessorChain<FilterBand, FilterBand, FilterBand, FilterBand, FilterBand, FilterBand, Gain> filter;
+    // the host bypass crossfades between the filtered and the dry signal, 0 is filtered.
+    // Once fully bypassed the filters stop, and start again from rest.
+    static constexpr double bypassFadeSeconds = 0.01;
+    double                  bypassMix         = 0;
+    AudioBuffer<float>      dryFloatBuffer;
+    AudioBuffer<double>     dryDoubleBuffer;
+
+    // after a while of silence in and out, the filters are suspended until signal arrives
+    static constexpr double silenceThreshold   = 1.0e-6;   // -120 dB
+    static constexpr double silenceHoldSeconds = 0.1;
+    int                     silentSamples      = 0;
+    bool                    suspended          = false;
+
+    // the decay of the active bands, reported to the host
+    std::atomic<double>     tailLength         { 0 };
+    double                  reportedTailLength = 0;
+
+    //==============================================================================
+    /** The audio thread's view of a band. The frequency, gain and quality are smoothed as
+        log2 values, which for the gain is the same as smoothing in dB, and the coefficients
+        are designed from them at control rate. */
+    struct SmoothedBand
+    {
+        void readTargets (int numSteps);
+        bool advance();
+
+        float* typeParameter      = nullptr;
+        float* frequencyParameter = nullptr;
+        float* qualityParameter   = nullptr;
+        float* gainParameter      = nullptr;
+        float* slopeParameter     = nullptr;
+        float* routingParameter   = nullptr;
+
+        // log2 of frequency, gain and quality
+        static constexpr size_t numValues = 3;
+        FilterType type     = NoFilter;
+        int        slope    = 0;
+        ChannelRouting routing = ChannelRouting::Stereo;
+        double values  [numValues] {};
+        double targets [numValues] {};
+        double steps   [numValues] {};
+        int    stepsLeft = 0;
+        bool   changed   = true;
+    };
+
+    static constexpr int    controlInterval  = 32;
+    static constexpr double smoothingSeconds = 0.02;
+
+    // the control rate runs on across blocks, so it doesn't depend on the host's block size
+    size_t samplesUntilControl = 0;
+
+    std::vector<SmoothedBand> smoothedBands;
+
+    // the output gain is smoothed linearly at control rate, the cascade ramps it in between
+    float*  outputParameter = nullptr;
+    double  outputGain      = 1;
+    double  outputTarget    = 1;
+    double  outputStep      = 0;
+    int     outputStepsLeft = 0;
+
+    // the bands designed in a control step, and their values converted in one batch
+    std::array<size_t, maxNumBands>                          designedBands;
+    std::array<double, SmoothedBand::numValues * maxNumBands> designedValues;
+
+    template<typename SampleType, typename IOType = SampleType>
+    using SvfCascade = FilterCascade<SampleType, IOType, FilterTopology::StateVariable>;
+
+    // only one of them runs at a time, depending on the host's and the selected precision and topology
+    FilterCascade<float>          floatFilter;
+    FilterCascade<double, float>  mixedFilter;
+    FilterCascade<double>         doubleFilter;
+    SvfCascade<float>             floatSvf;
+    SvfCascade<double, float>     mixedSvf;
+    SvfCascade<double>            doubleSvf;
+    const void*                   currentFilter = nullptr;
+    float*                        precisionParameter = nullptr;
+    float*                        topologyParameter  = nullptr;
+
+    float*                        engineParameter = nullptr;
+    Engine                        runningEngine   = EngineMinimumPhase;
+
+    // a FIR with the magnitude response of the bands instead of the cascade, its kernel is
+    // long enough to resolve the lowest band frequencies and is made on the updater thread
+    static constexpr double       linearPhaseSeconds = 0.17;
+    LinearPhaseConvolver          linearPhaseConvolver;
+    std::vector<double>           kernelFrequencies;
+    EngineResponse                kernelResponse;
+
+    // the response as gains per bin of an STFT, which costs the same for any number of bands
+    SpectralEqualizer             spectralEqualizer;
+    std::vector<double>           spectralFrequencies;
+    EngineResponse                spectralResponse;
+
+    std::vector<double>           responseBandMagnitudes;
+
+    // analog matched peak and shelf designs instead of the bilinear transform
+    float*                        designParameter = nullptr;
+    bool                          matchedDesign   = false;
 
     double sampleRate = 0;
 
-    int soloed = -1;
+    // solo and active states are published to the audio thread as one mask of bypassed bands,
+    // which it hands to the current cascade at the start of each block
+    std::atomic<int>    soloed        { -1 };
+    std::atomic<uint64> bypassedBands { 0 };
+    uint64              appliedBypass = 0;
+
+    // whether the layout is stereo, updated in prepareToPlay
+    std::atomic<bool>   routingAvailable { true };
 
     Analyser<float> inputAnalyser;
     Analyser<float> outputAnalyser;
+    std::atomic<int> analyserTap { -1 };    // the pair of channels, -1 for all
 
     Point<int> editorSize = { 900, 500 };
+
+    //==============================================================================
+    /** Designs the filters and computes the plots away from the audio thread.
+        parameterChanged only flags the bands that need an update and wakes it up. */
+    class BandUpdater : public Thread
+    {
+    public:
+        BandUpdater (FrequalizerAudioProcessor& p) : Thread ("Frequalizer-Updater"), processor (p) {}
+        void run() override;
+    private:
+        FrequalizerAudioProcessor& processor;
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BandUpdater)
+    };
+
+    std::atomic<uint64> pendingBands { 0 };
+    std::atomic<bool>   pendingPlots { false };
+    CriticalSection     bandsLock;
+    BandUpdater         updater { *this };
 };
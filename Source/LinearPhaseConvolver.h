@@ -0,0 +1,502 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer linear phase convolver
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Runs a linear phase FIR kernel as a uniformly partitioned overlap-save
+    convolution.
+
+    The kernel is cut into partitions of partitionSize samples. Each block of
+    partitionSize input samples is transformed once and kept in a frequency
+    domain delay line, so a block costs one forward and one inverse FFT plus a
+    complex multiply-accumulate of every partition, which runs on
+    dsp::SIMDRegister. The latency is half the kernel plus one partition.
+
+    Kernels are made from a magnitude response away from the audio thread and
+    handed over with setKernel() without locking. The audio thread picks them
+    up at the next partition and crossfades from the previous kernel. Until
+    the first kernel arrives the output is the delayed input, which the first
+    kernel crossfades from as well.
+
+    The input of the last kernelLength + 2 * partitionSize samples is kept in
+    a history. delay() runs that history for the latency matched dry signal of
+    a bypass, and keeps the spectra of the partitions up to date, which is one
+    forward FFT per partition and channel. When process() follows it, only the
+    output of the current partition is computed, so it resumes exactly where
+    continuous processing would be, at the cost of one partition.
+
+    A kernel either filters every channel alike, or is a stereo matrix of four
+    responses, from the left and right input to each of the first two outputs.
+    The matrix convolves both inputs for each output, so it costs twice as much.
+
+    The convolution runs in float, buffers of other precision are converted.
+*/
+class LinearPhaseConvolver
+{
+public:
+    static constexpr size_t partitionSize = 256;
+
+    /** The responses of a stereo matrix, in the order left to left, right to left,
+        left to right and right to right. */
+    static constexpr size_t numMatrixResponses = 4;
+
+    /** The partitions of a kernel's responses, transformed and ready to run. */
+    struct Kernel
+    {
+        Kernel (size_t numPartitionsToUse, size_t numBinsToUse, size_t numResponsesToUse)
+          : numPartitions (numPartitionsToUse), numBins (numBinsToUse), numResponses (numResponsesToUse)
+        {
+            real = allocateAligned (data, 2 * numResponses * numPartitions * numBins);
+            imag = real + numResponses * numPartitions * numBins;
+        }
+
+        size_t           numPartitions;
+        size_t           numBins;
+        size_t           numResponses;
+        HeapBlock<char>  data;
+        float*           real = nullptr;
+        float*           imag = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Kernel)
+    };
+
+    LinearPhaseConvolver() = default;
+
+    ~LinearPhaseConvolver()
+    {
+        releaseKernels();
+    }
+
+    /** Allocates everything for a kernel of kernelLengthToUse samples, a power of two of at
+        least two partitions. Must not be called while processing or setting kernels. */
+    void prepare (size_t numChannelsToUse, size_t kernelLengthToUse)
+    {
+        jassert (isPowerOfTwo (kernelLengthToUse) && kernelLengthToUse >= 2 * partitionSize);
+
+        releaseKernels();
+
+        numChannels   = numChannelsToUse;
+        kernelLength  = kernelLengthToUse;
+        numPartitions = kernelLength / partitionSize;
+
+        // the bins up to Nyquist of a 2 * partitionSize transform, padded for the SIMD loop
+        const auto numLanes = dsp::SIMDRegister<float>::size();
+        numBins = (partitionSize + 1 + numLanes - 1) / numLanes * numLanes;
+
+        historySize = size_t (nextPowerOfTwo (int (kernelLength + 2 * partitionSize)));
+
+        fft = std::make_unique<dsp::FFT> (roundToInt (std::log2 (double (2 * partitionSize))));
+        fftBuffer.calloc (4 * partitionSize);
+
+        history.setSize (int (numChannels), int (historySize));
+        output.setSize (int (numChannels), int (partitionSize));
+        previousOutput.setSize (int (numChannels), int (partitionSize));
+
+        spectrumReal = allocateAligned (spectrumData, 2 * numChannels * numPartitions * numBins + 2 * numBins);
+        spectrumImag = spectrumReal + numChannels * numPartitions * numBins;
+        sumReal      = spectrumImag + numChannels * numPartitions * numBins;
+        sumImag      = sumReal + numBins;
+
+        reset();
+    }
+
+    /** Clears the input history and the convolution state. */
+    void reset()
+    {
+        history.clear();
+        output.clear();
+        writePosition = 0;
+        fifoPosition  = 0;
+        newestSpectrum = 0;
+        isWarm = false;
+        std::fill (spectrumReal, spectrumReal + 2 * numChannels * numPartitions * numBins, 0.0f);
+    }
+
+    size_t getKernelLength() const
+    {
+        return kernelLength;
+    }
+
+    int getLatencySamples() const
+    {
+        return int (kernelLength / 2 + partitionSize);
+    }
+
+    /** Makes a linear phase kernel from the magnitudes at the frequencies
+        k * sampleRate / getKernelLength() for k from 0 to getKernelLength() / 2.
+        This allocates, so it is meant for a background thread. */
+    std::unique_ptr<Kernel> makeKernel (const double* magnitudes) const
+    {
+        return makeKernel (&magnitudes, 1);
+    }
+
+    /** Makes a stereo matrix kernel from numMatrixResponses real responses at the same
+        frequencies as makeKernel(). They may be negative where a matrix subtracts. */
+    std::unique_ptr<Kernel> makeMatrixKernel (const double* const* responses) const
+    {
+        return makeKernel (responses, numMatrixResponses);
+    }
+
+    /** Hands a kernel to the audio thread. It replaces one that wasn't picked up yet, and
+        frees the one the audio thread is done with. Call it from one thread only, not the
+        audio thread. */
+    void setKernel (std::unique_ptr<Kernel> kernel)
+    {
+        delete retiredKernel.exchange (nullptr);
+        delete pendingKernel.exchange (kernel.release());
+    }
+
+    /** Convolves the buffer in place. If delayedInput is given, it gets the input delayed
+        by the same latency, for a dry signal that lines up. */
+    template<typename IOType>
+    void process (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput = nullptr)
+    {
+        if (! isWarm)
+            warmUp();
+
+        run<true> (buffer, delayedInput);
+    }
+
+    /** Only delays the buffer by the latency, and transforms the input partitions for the
+        convolution to resume from. */
+    template<typename IOType>
+    void delay (AudioBuffer<IOType>& buffer)
+    {
+        isWarm = false;
+        run<false, IOType> (buffer, nullptr);
+    }
+
+private:
+    std::unique_ptr<Kernel> makeKernel (const double* const* responses, size_t numResponses) const
+    {
+        auto kernel = std::make_unique<Kernel> (numPartitions, numBins, numResponses);
+        for (size_t r = 0; r < numResponses; ++r)
+            transformResponse (responses [r], kernel->real + r * numPartitions * numBins, kernel->imag + r * numPartitions * numBins);
+
+        return kernel;
+    }
+
+    /** Turns the magnitudes into a windowed linear phase impulse, and transforms its partitions. */
+    void transformResponse (const double* magnitudes, float* real, float* imag) const
+    {
+        const auto n = kernelLength;
+        HeapBlock<float> impulse (2 * n, true);
+
+        // a delay of n / 2 turns every other bin around
+        for (size_t k = 0; k <= n / 2; ++k)
+            impulse [2 * k] = float ((k & 1) != 0 ? -magnitudes [k] : magnitudes [k]);
+
+        dsp::FFT (roundToInt (std::log2 (double (n)))).performRealOnlyInverseTransform (impulse);
+
+        // a periodic Blackman window is symmetric around n / 2, so the phase stays linear
+        for (size_t i = 0; i < n; ++i)
+        {
+            const auto phase = MathConstants<double>::twoPi * double (i) / double (n);
+            impulse [i] *= float (0.42 - 0.5 * std::cos (phase) + 0.08 * std::cos (2.0 * phase));
+        }
+
+        dsp::FFT partitionFFT (roundToInt (std::log2 (double (2 * partitionSize))));
+        HeapBlock<float> block (4 * partitionSize);
+
+        for (size_t p = 0; p < numPartitions; ++p)
+        {
+            std::fill (block.get(), block.get() + 4 * partitionSize, 0.0f);
+            std::copy (impulse.get() + p * partitionSize, impulse.get() + (p + 1) * partitionSize, block.get());
+            partitionFFT.performRealOnlyForwardTransform (block, true);
+            deinterleave (block, real + p * numBins, imag + p * numBins);
+        }
+    }
+
+    template<bool convolve, typename IOType>
+    void run (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput)
+    {
+        const auto numToProcess = jmin (size_t (buffer.getNumChannels()), numChannels);
+        const auto latency      = size_t (getLatencySamples());
+        const auto mask         = historySize - 1;
+
+        for (int start = 0; start < buffer.getNumSamples();)
+        {
+            const auto num = jmin (size_t (buffer.getNumSamples() - start), partitionSize - fifoPosition);
+
+            for (size_t ch = 0; ch < numToProcess; ++ch)
+            {
+                auto* samples = buffer.getWritePointer (int (ch), start);
+                auto* past    = history.getWritePointer (int (ch));
+                const auto* wet = output.getReadPointer (int (ch), int (fifoPosition));
+                IOType* dry = delayedInput != nullptr ? delayedInput->getWritePointer (int (ch), start) : nullptr;
+
+                for (size_t n = 0; n < num; ++n)
+                {
+                    const auto position = writePosition + n;
+                    const auto delayed  = past [(position - latency) & mask];
+                    past [position & mask] = float (samples [n]);
+
+                    if (dry != nullptr)
+                        dry [n] = IOType (delayed);
+
+                    samples [n] = IOType (convolve ? wet [n] : delayed);
+                }
+            }
+
+            writePosition += num;
+            fifoPosition  += num;
+            start         += int (num);
+
+            if (fifoPosition == partitionSize)
+            {
+                fifoPosition = 0;
+                newestSpectrum = (newestSpectrum + 1) % numPartitions;
+
+                if (convolve)
+                {
+                    processPartition();
+                }
+                else
+                {
+                    for (size_t ch = 0; ch < numChannels; ++ch)
+                        transformInput (ch, newestSpectrum, writePosition);
+                }
+            }
+        }
+    }
+
+    /** Transforms the last partition of every channel and computes its next output. */
+    void processPartition()
+    {
+        // a kernel the audio thread is done with waits until the slot for freeing it is empty
+        if (finishedKernel != nullptr)
+        {
+            Kernel* empty = nullptr;
+            if (retiredKernel.compare_exchange_strong (empty, finishedKernel))
+                finishedKernel = nullptr;
+        }
+
+        // a new kernel only starts when the last crossfade is done and its kernel was handed back
+        if (! crossfading && finishedKernel == nullptr)
+        {
+            if (auto* kernel = pendingKernel.exchange (nullptr))
+            {
+                if (kernel->numPartitions != numPartitions || kernel->numBins != numBins)
+                {
+                    finishedKernel = kernel;
+                }
+                else
+                {
+                    previousKernel = currentKernel;
+                    currentKernel  = kernel;
+                    fadePosition   = 0;
+                    crossfading    = true;
+                }
+            }
+        }
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+            transformInput (ch, newestSpectrum, writePosition);
+
+        computeOutput (writePosition);
+    }
+
+    /** Computes the output of the partition that starts at partitionEnd. */
+    void computeOutput (size_t partitionEnd)
+    {
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* wet = output.getWritePointer (int (ch));
+            render (currentKernel, ch, partitionEnd, wet);
+
+            if (crossfading)
+            {
+                auto* old = previousOutput.getWritePointer (int (ch));
+                render (previousKernel, ch, partitionEnd, old);
+
+                for (size_t n = 0; n < partitionSize; ++n)
+                {
+                    const auto gain = float (fadePosition + n + 1) / float (fadeLength);
+                    wet [n] = old [n] + gain * (wet [n] - old [n]);
+                }
+            }
+        }
+
+        if (crossfading)
+        {
+            fadePosition += partitionSize;
+            if (fadePosition >= fadeLength)
+            {
+                finishedKernel = previousKernel;
+                previousKernel = nullptr;
+                crossfading    = false;
+            }
+        }
+    }
+
+    /** The output of a kernel, or the delayed input without one. */
+    void render (const Kernel* kernel, size_t channel, size_t partitionEnd, float* result)
+    {
+        if (kernel != nullptr)
+        {
+            convolve (*kernel, channel, result);
+            return;
+        }
+
+        const auto* past   = history.getReadPointer (int (channel));
+        const auto latency = size_t (getLatencySamples());
+        const auto mask    = historySize - 1;
+        for (size_t n = 0; n < partitionSize; ++n)
+            result [n] = past [(partitionEnd + n - latency) & mask];
+    }
+
+    /** Puts the spectrum of the 2 * partitionSize input samples up to end into the slot. */
+    void transformInput (size_t channel, size_t slot, size_t end)
+    {
+        const auto* past = history.getReadPointer (int (channel));
+        const auto mask  = historySize - 1;
+        for (size_t i = 0; i < 2 * partitionSize; ++i)
+            fftBuffer [i] = past [(end - 2 * partitionSize + i) & mask];
+
+        std::fill (fftBuffer.get() + 2 * partitionSize, fftBuffer.get() + 4 * partitionSize, 0.0f);
+        fft->performRealOnlyForwardTransform (fftBuffer, true);
+
+        const auto offset = (channel * numPartitions + slot) * numBins;
+        deinterleave (fftBuffer, spectrumReal + offset, spectrumImag + offset);
+    }
+
+    /** Multiplies each partition of the kernel with the spectrum of the input as many
+        partitions ago, sums them up and transforms back. The second half of the result
+        is the next output, the first half is circular wrap around. A stereo matrix sums
+        up the responses from both inputs for each of the first two outputs. */
+    void convolve (const Kernel& kernel, size_t channel, float* result)
+    {
+        using SIMDType = dsp::SIMDRegister<float>;
+        const auto numLanes  = SIMDType::size();
+        const auto matrix    = kernel.numResponses == numMatrixResponses && numChannels >= 2 && channel < 2;
+        const auto numInputs = matrix ? size_t (2) : size_t (1);
+
+        for (size_t i = 0; i < numBins; i += numLanes)
+        {
+            auto re = SIMDType::expand (0.0f);
+            auto im = SIMDType::expand (0.0f);
+
+            for (size_t input = 0; input < numInputs; ++input)
+            {
+                const auto inputChannel = matrix ? input : channel;
+                const auto response     = matrix ? 2 * channel + input : 0;
+                const auto* inputReal   = spectrumReal + inputChannel * numPartitions * numBins;
+                const auto* inputImag   = spectrumImag + inputChannel * numPartitions * numBins;
+                const auto* kernelReal  = kernel.real + response * numPartitions * numBins;
+                const auto* kernelImag  = kernel.imag + response * numPartitions * numBins;
+
+                for (size_t p = 0; p < numPartitions; ++p)
+                {
+                    const auto slot = (newestSpectrum + numPartitions - p) % numPartitions;
+                    const auto xr = SIMDType::fromRawArray (inputReal + slot * numBins + i);
+                    const auto xi = SIMDType::fromRawArray (inputImag + slot * numBins + i);
+                    const auto kr = SIMDType::fromRawArray (kernelReal + p * numBins + i);
+                    const auto ki = SIMDType::fromRawArray (kernelImag + p * numBins + i);
+
+                    re += xr * kr - xi * ki;
+                    im += xr * ki + xi * kr;
+                }
+            }
+
+            re.copyToRawArray (sumReal + i);
+            im.copyToRawArray (sumImag + i);
+        }
+
+        for (size_t k = 0; k <= partitionSize; ++k)
+        {
+            fftBuffer [2 * k]     = sumReal [k];
+            fftBuffer [2 * k + 1] = sumImag [k];
+        }
+
+        fft->performRealOnlyInverseTransform (fftBuffer);
+        std::copy (fftBuffer.get() + partitionSize, fftBuffer.get() + 2 * partitionSize, result);
+    }
+
+    /** Computes the output of the current partition, which delay() left out. */
+    void warmUp()
+    {
+        computeOutput (writePosition - fifoPosition);
+        isWarm = true;
+    }
+
+    void deinterleave (const float* interleaved, float* real, float* imag) const
+    {
+        for (size_t k = 0; k <= partitionSize; ++k)
+        {
+            real [k] = interleaved [2 * k];
+            imag [k] = interleaved [2 * k + 1];
+        }
+
+        std::fill (real + partitionSize + 1, real + numBins, 0.0f);
+        std::fill (imag + partitionSize + 1, imag + numBins, 0.0f);
+    }
+
+    void releaseKernels()
+    {
+        delete pendingKernel.exchange (nullptr);
+        delete retiredKernel.exchange (nullptr);
+        delete currentKernel;
+        delete previousKernel;
+        delete finishedKernel;
+        currentKernel  = nullptr;
+        previousKernel = nullptr;
+        finishedKernel = nullptr;
+        crossfading    = false;
+    }
+
+    static float* allocateAligned (HeapBlock<char>& data, size_t num)
+    {
+        const auto alignment = alignof (dsp::SIMDRegister<float>);
+        data.calloc (num * sizeof (float) + alignment);
+        const auto address = reinterpret_cast<uintptr_t> (data.getData());
+        return reinterpret_cast<float*> ((address + alignment - 1) & ~uintptr_t (alignment - 1));
+    }
+
+    static constexpr size_t fadeLength = 4 * partitionSize;
+
+    size_t numChannels   = 0;
+    size_t kernelLength  = 0;
+    size_t numPartitions = 0;
+    size_t numBins       = 0;
+
+    std::unique_ptr<dsp::FFT> fft;
+    HeapBlock<float>          fftBuffer;
+
+    // the input, written at writePosition, and the output of the current partition
+    AudioBuffer<float> history;
+    AudioBuffer<float> output;
+    AudioBuffer<float> previousOutput;
+    size_t             historySize   = 0;
+    size_t             writePosition = 0;
+    size_t             fifoPosition  = 0;
+    bool               isWarm        = false;
+
+    // the spectra of the last numPartitions input partitions for each channel
+    HeapBlock<char>    spectrumData;
+    float*             spectrumReal  = nullptr;
+    float*             spectrumImag  = nullptr;
+    float*             sumReal       = nullptr;
+    float*             sumImag       = nullptr;
+    size_t             newestSpectrum = 0;
+
+    // the kernels: the audio thread owns the current, previous and finished one,
+    // the pending and retired one pass between threads. No kernel is the delayed input.
+    Kernel*              currentKernel  = nullptr;
+    Kernel*              previousKernel = nullptr;
+    Kernel*              finishedKernel = nullptr;
+    size_t               fadePosition   = 0;
+    bool                 crossfading    = false;
+    std::atomic<Kernel*> pendingKernel  { nullptr };
+    std::atomic<Kernel*> retiredKernel  { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LinearPhaseConvolver)
+};
@@ -0,0 +1,399 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer spectral equalizer
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Analyser.h"
+
+//==============================================================================
+/**
+    Applies a magnitude response as a gain per bin in an overlap-add STFT.
+
+    Every hop of a quarter frame, the last frame of input is windowed with a
+    Hann window, transformed, multiplied with the gains, transformed back and
+    added to the output with a second Hann window. The cost is one forward and
+    one inverse FFT per hop and channel, however many bands make up the gains.
+    The gains are real, so the phase stays linear, with a latency of a frame.
+    Instead of one gain for all channels there may be a stereo matrix, which
+    mixes the left and right spectra of each frame before they go back.
+
+    The frames have the size of the analyser's FFT and a Hann window like it,
+    so the spectra of the input and the output can be handed to the analysers
+    as they are, instead of being transformed again.
+
+    Gains are made away from the audio thread and handed over with setGains()
+    without locking. The windows overlap, so a new set of gains fades in over
+    a frame by itself.
+
+    Like the LinearPhaseConvolver the input is kept in a history, and delay()
+    only runs that for a bypass. When process() follows, the frames start again
+    from the next hop, one per hop as usual. The delayed input makes up for the
+    frames that are missing from the overlap, so the output fades from the dry
+    signal to the filtered one over a frame.
+*/
+class SpectralEqualizer
+{
+public:
+    static constexpr int    fftOrder  = Analyser<float>::fftOrder;
+    static constexpr size_t frameSize = size_t (1) << fftOrder;
+    static constexpr size_t hopSize   = frameSize / 4;
+    static constexpr size_t numBins   = frameSize / 2 + 1;
+
+    /** The responses of a stereo matrix, in the order left to left, right to left,
+        left to right and right to right. */
+    static constexpr size_t numMatrixResponses = 4;
+
+    /** The gain of each bin, from 0 up to Nyquist, for each response one after the other. */
+    using Gains = std::vector<float>;
+
+    SpectralEqualizer() = default;
+
+    ~SpectralEqualizer()
+    {
+        releaseGains();
+    }
+
+    /** Allocates everything, must not be called while processing or setting gains. */
+    void prepare (size_t numChannelsToUse)
+    {
+        releaseGains();
+        numChannels = numChannelsToUse;
+        setAnalysedChannels (0, numChannels);
+
+        // periodic windows, from a table one longer than the frame
+        analysisWindow.calloc (frameSize + 1);
+        synthesisWindow.calloc (frameSize + 1);
+        dsp::WindowingFunction<float>::fillWindowingTables (analysisWindow,  frameSize + 1, dsp::WindowingFunction<float>::hann, true);
+        dsp::WindowingFunction<float>::fillWindowingTables (synthesisWindow, frameSize + 1, dsp::WindowingFunction<float>::hann, false);
+
+        // the overlapping products of both windows add up to a constant, which is taken out
+        float overlap = 0.0f;
+        for (size_t i = 0; i < frameSize; i += hopSize)
+            overlap += analysisWindow [i] * synthesisWindow [i];
+
+        FloatVectorOperations::multiply (synthesisWindow, 1.0f / overlap, int (frameSize));
+
+        // after a restart, the share of the delayed input in each hop until the frames overlap again
+        dryWeights.calloc ((numOverlaps - 1) * hopSize);
+        for (size_t hop = 0; hop + 1 < numOverlaps; ++hop)
+        {
+            for (size_t i = 0; i < hopSize; ++i)
+            {
+                auto weight = 1.0f;
+                for (size_t frame = 0; frame <= hop; ++frame)
+                    weight -= analysisWindow [frame * hopSize + i] * synthesisWindow [frame * hopSize + i];
+
+                dryWeights [hop * hopSize + i] = weight;
+            }
+        }
+
+        frames.calloc (2 * frameSize * numChannels);
+        spectrumReal.calloc (numBins);
+        spectrumImag.calloc (numBins);
+        magnitudes.calloc (numBins);
+
+        history.setSize (int (numChannels), int (historySize));
+        accumulator.setSize (int (numChannels), int (frameSize));
+        output.setSize (int (numChannels), int (hopSize));
+
+        currentGains = new Gains (size_t (numBins), 1.0f);
+
+        reset();
+    }
+
+    /** Clears the input history and the frames. */
+    void reset()
+    {
+        history.clear();
+        accumulator.clear();
+        output.clear();
+        writePosition = 0;
+        fifoPosition  = 0;
+        isWarm = false;
+    }
+
+    /** The channels whose sum goes to the analysers, all of them by default. */
+    void setAnalysedChannels (size_t first, size_t num)
+    {
+        firstAnalysed = jmin (first, numChannels);
+        numAnalysed   = jmin (num, numChannels - firstAnalysed);
+    }
+
+    int getLatencySamples() const
+    {
+        return int (frameSize);
+    }
+
+    /** Makes the gains from the magnitudes at the frequencies k * sampleRate / frameSize
+        for k up to numBins. This allocates, so it is meant for a background thread. */
+    static std::unique_ptr<Gains> makeGains (const double* magnitudeList)
+    {
+        auto gains = std::make_unique<Gains> (size_t (numBins));
+        for (size_t k = 0; k < numBins; ++k)
+            (*gains) [k] = float (magnitudeList [k]);
+
+        return gains;
+    }
+
+    /** Makes a stereo matrix from numMatrixResponses real responses at the same frequencies
+        as makeGains(). They may be negative where a matrix subtracts. */
+    static std::unique_ptr<Gains> makeMatrixGains (const double* const* responses)
+    {
+        auto gains = std::make_unique<Gains> (numMatrixResponses * numBins);
+        for (size_t r = 0; r < numMatrixResponses; ++r)
+            for (size_t k = 0; k < numBins; ++k)
+                (*gains) [r * numBins + k] = float (responses [r][k]);
+
+        return gains;
+    }
+
+    /** Hands gains to the audio thread. They replace ones that weren't picked up yet, and
+        the ones the audio thread is done with are freed. Call it from one thread only, not
+        the audio thread. */
+    void setGains (std::unique_ptr<Gains> gains)
+    {
+        delete retiredGains.exchange (nullptr);
+        delete pendingGains.exchange (gains.release());
+    }
+
+    /** Filters the buffer in place. If delayedInput is given, it gets the input delayed by
+        the same latency. The spectra of each frame go to the analysers that are given. */
+    template<typename IOType>
+    void process (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput = nullptr,
+                  Analyser<float>* inputAnalyser = nullptr, Analyser<float>* outputAnalyser = nullptr)
+    {
+        if (! isWarm)
+            warmUp();
+
+        run<true> (buffer, delayedInput, inputAnalyser, outputAnalyser);
+    }
+
+    /** Only delays the buffer by the latency, the frames stop. */
+    template<typename IOType>
+    void delay (AudioBuffer<IOType>& buffer)
+    {
+        isWarm = false;
+        run<false, IOType> (buffer, nullptr, nullptr, nullptr);
+    }
+
+private:
+    template<bool filter, typename IOType>
+    void run (AudioBuffer<IOType>& buffer, AudioBuffer<IOType>* delayedInput,
+              Analyser<float>* inputAnalyser, Analyser<float>* outputAnalyser)
+    {
+        const auto numToProcess = jmin (size_t (buffer.getNumChannels()), numChannels);
+        const auto mask         = historySize - 1;
+
+        for (int start = 0; start < buffer.getNumSamples();)
+        {
+            const auto num = jmin (size_t (buffer.getNumSamples() - start), hopSize - fifoPosition);
+
+            for (size_t ch = 0; ch < numToProcess; ++ch)
+            {
+                auto* samples = buffer.getWritePointer (int (ch), start);
+                auto* past    = history.getWritePointer (int (ch));
+                const auto* wet = output.getReadPointer (int (ch), int (fifoPosition));
+                IOType* dry = delayedInput != nullptr ? delayedInput->getWritePointer (int (ch), start) : nullptr;
+
+                for (size_t n = 0; n < num; ++n)
+                {
+                    const auto position = writePosition + n;
+                    const auto delayed  = past [(position - frameSize) & mask];
+                    past [position & mask] = float (samples [n]);
+
+                    if (dry != nullptr)
+                        dry [n] = IOType (delayed);
+
+                    samples [n] = IOType (filter ? wet [n] : delayed);
+                }
+            }
+
+            writePosition += num;
+            fifoPosition  += num;
+            start         += int (num);
+
+            if (fifoPosition == hopSize)
+            {
+                fifoPosition = 0;
+
+                if (filter)
+                    processFrame (writePosition, inputAnalyser, outputAnalyser);
+            }
+        }
+    }
+
+    /** Filters the frame of input up to end, and moves the output on by a hop. */
+    void processFrame (size_t end, Analyser<float>* inputAnalyser, Analyser<float>* outputAnalyser)
+    {
+        pickUpGains();
+
+        const auto mask    = historySize - 1;
+        const auto analyse = (inputAnalyser != nullptr || outputAnalyser != nullptr) && numAnalysed > 0;
+        const auto* gains  = currentGains->data();
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* frame = frames + ch * 2 * frameSize;
+            const auto* past = history.getReadPointer (int (ch));
+            for (size_t i = 0; i < frameSize; ++i)
+                frame [i] = past [(end - frameSize + i) & mask] * analysisWindow [i];
+
+            fft.performRealOnlyForwardTransform (frame, true);
+        }
+
+        if (analyse && inputAnalyser != nullptr)
+            inputAnalyser->addSpectrum (getAnalysedMagnitudes());
+
+        if (currentGains->size() == numMatrixResponses * numBins && numChannels == 2)
+        {
+            auto* left  = frames.get();
+            auto* right = frames + 2 * frameSize;
+            for (size_t k = 0; k < 2 * numBins; ++k)
+            {
+                const auto bin = k / 2;
+                const auto l   = left [k];
+                const auto r   = right [k];
+                left [k]  = gains [bin] * l               + gains [numBins + bin] * r;
+                right [k] = gains [2 * numBins + bin] * l + gains [3 * numBins + bin] * r;
+            }
+        }
+        else
+        {
+            for (size_t ch = 0; ch < numChannels; ++ch)
+            {
+                auto* frame = frames + ch * 2 * frameSize;
+                for (size_t k = 0; k < numBins; ++k)
+                {
+                    frame [2 * k]     *= gains [k];
+                    frame [2 * k + 1] *= gains [k];
+                }
+            }
+        }
+
+        if (analyse && outputAnalyser != nullptr)
+            outputAnalyser->addSpectrum (getAnalysedMagnitudes());
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            auto* frame = frames + ch * 2 * frameSize;
+            fft.performRealOnlyInverseTransform (frame);
+
+            auto* sum = accumulator.getWritePointer (int (ch));
+            FloatVectorOperations::addWithMultiply (sum, frame, synthesisWindow, int (frameSize));
+
+            output.copyFrom (int (ch), 0, sum, int (hopSize));
+            std::copy (sum + hopSize, sum + frameSize, sum);
+            std::fill (sum + frameSize - hopSize, sum + frameSize, 0.0f);
+
+            if (numRestartedHops + 1 < numOverlaps)
+            {
+                const auto* past = history.getReadPointer (int (ch));
+                auto* wet = output.getWritePointer (int (ch));
+                const auto* weights = dryWeights + numRestartedHops * hopSize;
+                for (size_t i = 0; i < hopSize; ++i)
+                    wet [i] += weights [i] * past [(end - frameSize + i) & mask];
+            }
+        }
+
+        numRestartedHops = jmin (numRestartedHops + 1, numOverlaps);
+    }
+
+    /** The magnitudes of the sum of the analysed channels' spectra, as the analysers show it. */
+    const float* getAnalysedMagnitudes()
+    {
+        std::fill (spectrumReal.get(), spectrumReal.get() + numBins, 0.0f);
+        std::fill (spectrumImag.get(), spectrumImag.get() + numBins, 0.0f);
+
+        for (size_t ch = firstAnalysed; ch < firstAnalysed + numAnalysed; ++ch)
+        {
+            const auto* frame = frames + ch * 2 * frameSize;
+            for (size_t k = 0; k < numBins; ++k)
+            {
+                spectrumReal [k] += frame [2 * k];
+                spectrumImag [k] += frame [2 * k + 1];
+            }
+        }
+
+        for (size_t k = 0; k < numBins; ++k)
+            magnitudes [k] = std::sqrt (spectrumReal [k] * spectrumReal [k] + spectrumImag [k] * spectrumImag [k]);
+
+        return magnitudes;
+    }
+
+    /** Takes new gains, once the last ones could be handed back. */
+    void pickUpGains()
+    {
+        if (pendingGains.load() == nullptr)
+            return;
+
+        Gains* empty = nullptr;
+        if (retiredGains.compare_exchange_strong (empty, currentGains))
+            currentGains = pendingGains.exchange (nullptr);
+    }
+
+    /** Restarts the frames, the rest of the current hop is the delayed input. */
+    void warmUp()
+    {
+        accumulator.clear();
+
+        const auto lastHopEnd = writePosition - fifoPosition;
+        const auto mask       = historySize - 1;
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* past = history.getReadPointer (int (ch));
+            auto* wet        = output.getWritePointer (int (ch));
+            for (size_t i = 0; i < hopSize; ++i)
+                wet [i] = past [(lastHopEnd - frameSize + i) & mask];
+        }
+
+        numRestartedHops = 0;
+        isWarm = true;
+    }
+
+    void releaseGains()
+    {
+        delete pendingGains.exchange (nullptr);
+        delete retiredGains.exchange (nullptr);
+        delete currentGains;
+        currentGains = nullptr;
+    }
+
+    // the delayed input reaches back a frame and a hop
+    static constexpr size_t historySize = 2 * frameSize;
+    static constexpr size_t numOverlaps = frameSize / hopSize;
+
+    size_t numChannels   = 0;
+    size_t firstAnalysed = 0;
+    size_t numAnalysed   = 0;
+
+    dsp::FFT          fft { fftOrder };
+    HeapBlock<float>  frames;
+    HeapBlock<float>  analysisWindow;
+    HeapBlock<float>  synthesisWindow;
+    HeapBlock<float>  dryWeights;
+    HeapBlock<float>  spectrumReal;
+    HeapBlock<float>  spectrumImag;
+    HeapBlock<float>  magnitudes;
+
+    // the input, written at writePosition, the overlapping frames and the output of the current hop
+    AudioBuffer<float> history;
+    AudioBuffer<float> accumulator;
+    AudioBuffer<float> output;
+    size_t             writePosition = 0;
+    size_t             fifoPosition  = 0;
+    bool               isWarm        = false;
+    size_t             numRestartedHops = numOverlaps;
+
+    // the audio thread owns the current gains, the pending and retired ones pass between threads
+    Gains*              currentGains = nullptr;
+    std::atomic<Gains*> pendingGains { nullptr };
+    std::atomic<Gains*> retiredGains { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectralEqualizer)
+};
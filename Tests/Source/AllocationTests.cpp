@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer realtime allocation test
+
+  ==============================================================================
+*/
+
+#include "../../Source/FrequalizerProcessor.h"
+
+#include <cstdlib>
+#include <new>
+
+//==============================================================================
+// every allocation of the app goes through these, but only the ones made on a
+// thread that is counting are counted, so the updater and analysers can allocate
+namespace
+{
+    std::atomic<int> numAllocations { 0 };
+    thread_local bool countAllocations = false;
+
+    void* allocate (std::size_t size)
+    {
+        if (countAllocations)
+            ++numAllocations;
+
+        if (auto* memory = std::malloc (size > 0 ? size : 1))
+            return memory;
+
+        throw std::bad_alloc();
+    }
+}
+
+void* operator new   (std::size_t size)                       { return allocate (size); }
+void* operator new[] (std::size_t size)                       { return allocate (size); }
+void  operator delete   (void* memory) noexcept               { std::free (memory); }
+void  operator delete[] (void* memory) noexcept               { std::free (memory); }
+void  operator delete   (void* memory, std::size_t) noexcept  { std::free (memory); }
+void  operator delete[] (void* memory, std::size_t) noexcept  { std::free (memory); }
+
+//==============================================================================
+/**
+    Sweeps every parameter of the processor while it processes, in single and double
+    precision, and with a block size that doesn't fit the control rate. Changing the
+    parameters may allocate, processing must not.
+*/
+class AllocationTest : public UnitTest
+{
+public:
+    AllocationTest() : UnitTest ("Realtime allocations", "Frequalizer") {}
+
+    void runTest() override
+    {
+        beginTest ("parameter sweep, 32 bit");
+        sweep<float> (512);
+
+        beginTest ("parameter sweep, 64 bit");
+        sweep<double> (512);
+
+        beginTest ("parameter sweep, blocks across the control rate");
+        sweep<float> (100);
+    }
+
+private:
+    template<typename IOType>
+    void sweep (int blockSize)
+    {
+        FrequalizerAudioProcessor processor;
+        processor.setProcessingPrecision (std::is_same<IOType, double>::value ? AudioProcessor::doublePrecision
+                                                                               : AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails (48000.0, blockSize);
+        processor.prepareToPlay (48000.0, blockSize);
+
+        AudioBuffer<IOType> buffer (processor.getTotalNumOutputChannels(), blockSize);
+        MidiBuffer midi;
+        Random random (42);
+
+        auto process = [&] (bool bypassed)
+        {
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                for (int n = 0; n < buffer.getNumSamples(); ++n)
+                    buffer.setSample (ch, n, IOType (random.nextFloat() * 0.5f - 0.25f));
+
+            countAllocations = true;
+            if (bypassed)
+                processor.processBlockBypassed (buffer, midi);
+            else
+                processor.processBlock (buffer, midi);
+            countAllocations = false;
+        };
+
+        for (auto* parameter : processor.getParameters())
+        {
+            numAllocations = 0;
+
+            // the smoothing is caught in every state, and bypass fades out and in again
+            for (auto value : { 0.0f, 0.3f, 1.0f, 0.7f, parameter->getDefaultValue() })
+            {
+                parameter->setValueNotifyingHost (value);
+                for (int block = 0; block < 4; ++block)
+                    process (false);
+            }
+
+            for (int block = 0; block < 4; ++block)
+                process (true);
+
+            expectEquals (numAllocations.load(), 0, "while sweeping " + parameter->getName (64));
+        }
+
+        processor.releaseResources();
+    }
+};
+
+static AllocationTest allocationTest;
@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer bypass test
+
+  ==============================================================================
+*/
+
+#include "../../Source/FrequalizerProcessor.h"
+
+//==============================================================================
+/**
+    Toggles the bypass with host blocks much longer than the processor was prepared
+    for. The fade runs in chunks of the prepared size, what is left of the block after
+    it must go on exactly like with blocks of the prepared size.
+*/
+class BypassTest : public UnitTest
+{
+public:
+    BypassTest() : UnitTest ("Bypass with oversized blocks", "Frequalizer") {}
+
+    void runTest() override
+    {
+        beginTest ("minimum phase, 32 bit");
+        compareBlockSizes<float> (1.0e-6);
+
+        beginTest ("minimum phase, 64 bit");
+        compareBlockSizes<double> (1.0e-12);
+
+        // the dry signal keeps the latency, whichever kernel the updater has made by then
+        beginTest ("linear phase delays the rest of the block");
+        checkDelayedRest (0.5f);
+
+        beginTest ("spectral delays the rest of the block");
+        checkDelayedRest (1.0f);
+    }
+
+private:
+    static constexpr double sampleRate    = 48000.0;
+    static constexpr int    preparedSize  = 64;
+    static constexpr int    oversizedSize = 8192;
+
+    template<typename IOType>
+    static AudioBuffer<IOType> makeNoise (int numChannels, int numSamples, Random& random)
+    {
+        AudioBuffer<IOType> buffer (numChannels, numSamples);
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int n = 0; n < numSamples; ++n)
+                buffer.setSample (ch, n, IOType (random.nextFloat() * 0.5f - 0.25f));
+
+        return buffer;
+    }
+
+    static void prepare (FrequalizerAudioProcessor& processor, bool doublePrecision)
+    {
+        processor.setProcessingPrecision (doublePrecision ? AudioProcessor::doublePrecision : AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails (sampleRate, preparedSize);
+        processor.prepareToPlay (sampleRate, preparedSize);
+    }
+
+    /** Processes the buffer in blocks of blockSize, bypassed or not. */
+    template<typename IOType>
+    static void process (FrequalizerAudioProcessor& processor, AudioBuffer<IOType>& buffer, int blockSize, bool bypassed)
+    {
+        MidiBuffer midi;
+        for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+        {
+            AudioBuffer<IOType> block (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start,
+                                       jmin (blockSize, buffer.getNumSamples() - start));
+            if (bypassed)
+                processor.processBlockBypassed (block, midi);
+            else
+                processor.processBlock (block, midi);
+        }
+    }
+
+    /** Fades to bypass and back with oversized blocks, and with blocks of the prepared
+        size, which need no chunking. Both must give the same output. */
+    template<typename IOType>
+    void compareBlockSizes (double tolerance)
+    {
+        const auto doublePrecision = std::is_same<IOType, double>::value;
+
+        FrequalizerAudioProcessor oversized, prepared;
+        prepare (oversized, doublePrecision);
+        prepare (prepared,  doublePrecision);
+
+        Random random (42);
+        const auto numChannels = oversized.getTotalNumOutputChannels();
+
+        for (auto bypassed : { false, true, false })
+        {
+            auto input = makeNoise<IOType> (numChannels, oversizedSize, random);
+            auto reference = input;
+
+            process (oversized, input,     oversizedSize, bypassed);
+            process (prepared,  reference, preparedSize,  bypassed);
+
+            auto deviation = 0.0;
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int n = 0; n < oversizedSize; ++n)
+                    deviation = jmax (deviation, std::abs (double (input.getSample (ch, n)) - double (reference.getSample (ch, n))));
+
+            expectLessThan (deviation, tolerance, bypassed ? "fading to bypass" : "filtering, or fading back to it");
+        }
+    }
+
+    /** Fades to bypass with an oversized block, after the fade the output must be the
+        input delayed by the latency. The engine is the normalised parameter value. */
+    void checkDelayedRest (float engine)
+    {
+        // preparing sets the latency of the selected engine right away
+        FrequalizerAudioProcessor processor;
+        processor.getPluginState().getParameter (FrequalizerAudioProcessor::paramEngine)->setValueNotifyingHost (engine);
+        prepare (processor, false);
+
+        Random random (42);
+        const auto numChannels = processor.getTotalNumOutputChannels();
+
+        auto history = makeNoise<float> (numChannels, oversizedSize, random);
+        auto filtered = history;
+        process (processor, filtered, oversizedSize, false);
+
+        auto input = makeNoise<float> (numChannels, oversizedSize, random);
+        auto output = input;
+        process (processor, output, oversizedSize, true);
+
+        const auto latency = processor.getLatencySamples();
+        expectGreaterThan (latency, 0, "the engine has latency");
+        expectLessThan (latency, oversizedSize, "the latency fits the history");
+
+        // the fade takes 10 ms
+        const auto settled = roundToInt (0.02 * sampleRate);
+
+        auto deviation = 0.0;
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            for (int n = settled; n < oversizedSize; ++n)
+            {
+                const auto delayed = n >= latency ? input.getSample (ch, n - latency)
+                                                  : history.getSample (ch, oversizedSize + n - latency);
+                deviation = jmax (deviation, std::abs (double (output.getSample (ch, n)) - double (delayed)));
+            }
+        }
+
+        expectLessThan (deviation, 1.0e-6, "after the fade");
+    }
+};
+
+static BypassTest bypassTest;
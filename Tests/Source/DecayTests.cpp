@@ -0,0 +1,167 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer decay estimate test
+
+  ==============================================================================
+*/
+
+#include "../../Source/FilterDesign.h"
+#include "TestUtilities.h"
+
+namespace FilterDesign
+{
+
+//==============================================================================
+/**
+    Compares the decay times estimated from the poles with simulated impulse responses,
+    down to the -120 dB the processor uses as its silence threshold. The estimate must
+    never be shorter than the response, so the host doesn't cut off a tail, and should
+    not be much longer, at any sample rate.
+*/
+class DecayTest : public UnitTest
+{
+public:
+    DecayTest() : UnitTest ("Filter design decay", "Frequalizer") {}
+
+    void runTest() override
+    {
+        beginTest ("sections against their impulse responses");
+        {
+            Errors errors;
+            for (auto sampleRate : { 44100.0, 96000.0, 192000.0 })
+            {
+                // 20 Hz up to 20 kHz in octaves, the processor keeps them below 0.49 * sampleRate
+                for (int step = 0; step <= 10; ++step)
+                {
+                    const auto frequency = jmin (20.0 * std::pow (2.0, step), 0.49 * sampleRate);
+                    errors.setting = String (frequency) + " Hz at " + String (sampleRate) + " Hz";
+
+                    compare ("first order low pass",  makeFirstOrderLowPass<double>  (sampleRate, frequency), sampleRate, errors);
+                    compare ("first order high pass", makeFirstOrderHighPass<double> (sampleRate, frequency), sampleRate, errors);
+                    compare ("first order all pass",  makeFirstOrderAllPass<double>  (sampleRate, frequency), sampleRate, errors);
+
+                    // around 0.5 the poles come together
+                    for (auto quality : { 0.1, 0.5, 0.55, 0.71, 2.0, 10.0 })
+                    {
+                        compare ("low pass",  makeLowPass<double>  (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("high pass", makeHighPass<double> (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("band pass", makeBandPass<double> (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("notch",     makeNotch<double>    (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("all pass",  makeAllPass<double>  (sampleRate, frequency, quality), sampleRate, errors);
+
+                        for (auto gain : { 0.125, 0.9, 8.0 })
+                        {
+                            compare ("peak",               makePeakFilter<double>        (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("low shelf",          makeLowShelf<double>          (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("high shelf",         makeHighShelf<double>         (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("matched peak",       makeMatchedPeakFilter<double> (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("matched low shelf",  makeMatchedLowShelf<double>   (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("matched high shelf", makeMatchedHighShelf<double>  (sampleRate, frequency, quality, gain), sampleRate, errors);
+                        }
+                    }
+                }
+            }
+
+            expect (errors.shortest.value >= 1.0, "shorter than the " + errors.shortest.design);
+            expect (errors.longest.value <= 1.5, "too long for the " + errors.longest.design);
+        }
+
+        beginTest ("steep slopes against their impulse responses");
+        {
+            Errors errors;
+            for (auto sampleRate : { 44100.0, 192000.0 })
+            {
+                for (auto frequency : { 20.0, 1000.0, 15000.0 })
+                {
+                    for (int order = 2; order <= 8; order += 2)
+                    {
+                        errors.setting = "order " + String (order) + ", " + String (frequency) + " Hz at " + String (sampleRate) + " Hz";
+
+                        compare ("Butterworth low pass",     makeButterworth<double>   (false, order, sampleRate, frequency, 0.71), sampleRate, errors);
+                        compare ("Butterworth high pass",    makeButterworth<double>   (true,  order, sampleRate, frequency, 0.71), sampleRate, errors);
+                        compare ("Linkwitz-Riley low pass",  makeLinkwitzRiley<double> (false, order, sampleRate, frequency),       sampleRate, errors);
+                        compare ("Linkwitz-Riley high pass", makeLinkwitzRiley<double> (true,  order, sampleRate, frequency),       sampleRate, errors);
+                    }
+                }
+            }
+
+            // the sections' decays add up, which is safe but long for many sections
+            expect (errors.shortest.value >= 1.0, "shorter than the " + errors.shortest.design);
+            expect (errors.longest.value <= 3.0, "too long for the " + errors.longest.design);
+        }
+
+        beginTest ("marginally stable sections");
+        {
+            // poles on the unit circle would ring forever
+            expectEquals (getDecaySeconds (Biquad<double> { 1.0, 0.0, 0.0, 0.0, 1.0 }, 48000.0, attenuation), 60.0);
+            expectEquals (getDecaySeconds (Biquad<double> { 1.0, 0.0, 0.0, 0.0, 1.0 }, 96000.0, attenuation), 60.0);
+        }
+    }
+
+private:
+    static constexpr double attenuation = 1.0e-6;
+
+    /** The shortest and longest estimates relative to the simulated decays so far, and
+        the setting of the designs being compared. */
+    struct Errors
+    {
+        WorstCase shortest { true }, longest;
+        String    setting;
+    };
+
+    /** Filters an impulse until the state has died away, and returns the sample after the
+        last one above the attenuation. */
+    static double simulateDecay (const Sections<Biquad<double>>& sections, double maxSamples)
+    {
+        std::array<double, maxSections> s1 {}, s2 {};
+        double decay = 0;
+        for (double n = 0; n < maxSamples; ++n)
+        {
+            auto y = n == 0 ? 1.0 : 0.0;
+            auto state = 0.0;
+            for (size_t k = 0; k < sections.size(); ++k)
+            {
+                const auto& c = sections [k];
+                const auto x = y;
+                y     = c.b0 * x + s1 [k];
+                s1 [k] = c.b1 * x - c.a1 * y + s2 [k];
+                s2 [k] = c.b2 * x - c.a2 * y;
+                state += std::abs (s1 [k]) + std::abs (s2 [k]);
+            }
+
+            if (std::abs (y) > attenuation)
+                decay = n + 1;
+            else if (state < 1.0e-4 * attenuation)
+                break;
+        }
+
+        return decay;
+    }
+
+    static void compare (const String& name, const Biquad<double>& c, double sampleRate, Errors& errors)
+    {
+        Sections<Biquad<double>> sections;
+        sections [0] = c;
+        compare (name, sections, sampleRate, errors);
+    }
+
+    static void compare (const String& name, const Sections<Biquad<double>>& sections, double sampleRate, Errors& errors)
+    {
+        // the estimate counts from the first sample and adds a few for the numerators,
+        // so very short responses are allowed those samples on top
+        const auto estimated = getDecaySeconds (sections, sampleRate, attenuation) * sampleRate;
+        const auto simulated = simulateDecay (sections, 60.0 * sampleRate);
+        const auto ratio     = estimated / jmax (simulated, 1.0);
+        const auto numUsed   = std::count_if (sections.begin(), sections.end(), [] (const Biquad<double>& c) { return ! isIdentity (c); });
+        const auto slack     = 3.0 * double (numUsed) / jmax (simulated, 1.0);
+
+        const auto design = name + " with " + errors.setting + ", " + String (estimated) + " estimated for " + String (simulated) + " samples";
+        errors.shortest.add (ratio, design);
+        errors.longest.add (ratio - slack, design);
+    }
+};
+
+static DecayTest decayTest;
+
+} // namespace FilterDesign
@@ -0,0 +1,174 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer linear phase and spectral engine test
+
+  ==============================================================================
+*/
+
+#include "../../Source/LinearPhaseConvolver.h"
+#include "../../Source/SpectralEqualizer.h"
+
+//==============================================================================
+/**
+    Runs the engines with odd host block sizes and a bypass stretch in the middle.
+    The convolver must match a direct convolution with its impulse response, and
+    the spectral equalizer must fade back in without overshooting.
+*/
+class EngineTest : public UnitTest
+{
+public:
+    EngineTest() : UnitTest ("Linear phase and spectral engines", "Frequalizer") {}
+
+    void runTest() override
+    {
+        beginTest ("convolver against a direct convolution");
+        checkConvolver();
+
+        beginTest ("spectral equalizer resuming from bypass");
+        checkSpectral();
+    }
+
+private:
+    static size_t getBlockSize (size_t block)
+    {
+        const size_t blockSizes[] = { 37, 512, 1, 300, 129, 2000 };
+        return blockSizes [block % (sizeof (blockSizes) / sizeof (blockSizes [0]))];
+    }
+
+    static std::vector<float> makeInput (size_t numSamples)
+    {
+        std::vector<float> input (numSamples);
+        for (size_t n = 0; n < numSamples; ++n)
+            input [n] = float (std::sin (double (n) * 0.37) + 0.3 * std::sin (double (n) * 0.051) + double ((n * 7919) % 13) / 13.0 - 0.5);
+
+        return input;
+    }
+
+    /** Runs the engine over the input in odd blocks, and only delays the blocks that start
+        within the bypass stretch. Marks the samples that were delayed. */
+    template<typename Engine>
+    static std::vector<float> run (Engine& engine, const std::vector<float>& input, int numChannels,
+                                   size_t bypassStart, size_t bypassEnd, std::vector<bool>& bypassed)
+    {
+        std::vector<float> output (input.size());
+        bypassed.assign (input.size(), false);
+
+        size_t block = 0;
+        for (size_t start = 0; start < input.size();)
+        {
+            const auto num = jmin (getBlockSize (block++), input.size() - start);
+            AudioBuffer<float> buffer (numChannels, int (num));
+            for (int ch = 0; ch < numChannels; ++ch)
+                std::copy (input.begin() + long (start), input.begin() + long (start + num), buffer.getWritePointer (ch));
+
+            if (start > bypassStart && start < bypassEnd)
+            {
+                engine.delay (buffer);
+                std::fill (bypassed.begin() + long (start), bypassed.begin() + long (start + num), true);
+            }
+            else
+            {
+                engine.process (buffer);
+            }
+
+            std::copy (buffer.getReadPointer (numChannels - 1), buffer.getReadPointer (numChannels - 1) + num, output.begin() + long (start));
+            start += num;
+        }
+
+        return output;
+    }
+
+    void checkConvolver()
+    {
+        const size_t kernelLength = 1024;
+        std::vector<double> magnitudes (kernelLength / 2 + 1);
+        for (size_t k = 0; k < magnitudes.size(); ++k)
+            magnitudes [k] = 0.5 + 0.5 * std::cos (double (k) * 0.01);
+
+        // the impulse response, once the kernel has been picked up
+        LinearPhaseConvolver impulseConvolver;
+        impulseConvolver.prepare (1, kernelLength);
+        impulseConvolver.setKernel (impulseConvolver.makeKernel (magnitudes.data()));
+        AudioBuffer<float> settle (1, 2048);
+        settle.clear();
+        impulseConvolver.process (settle);
+
+        AudioBuffer<float> impulse (1, int (kernelLength + 1000));
+        impulse.clear();
+        impulse.setSample (0, 0, 1.0f);
+        impulseConvolver.process (impulse);
+
+        LinearPhaseConvolver convolver;
+        convolver.prepare (1, kernelLength);
+        convolver.setKernel (convolver.makeKernel (magnitudes.data()));
+        settle.clear();
+        convolver.process (settle);
+
+        const size_t total = 6000, bypassStart = 2000, bypassEnd = 3000;
+        const auto input  = makeInput (total);
+        std::vector<bool> bypassed;
+        const auto output  = run (convolver, input, 1, bypassStart, bypassEnd, bypassed);
+        const auto latency = size_t (convolver.getLatencySamples());
+
+        auto filterDeviation = 0.0, dryDeviation = 0.0;
+        for (size_t n = 0; n < total; ++n)
+        {
+            if (bypassed [n])
+            {
+                const auto delayed = n >= latency ? double (input [n - latency]) : 0.0;
+                dryDeviation = jmax (dryDeviation, std::abs (double (output [n]) - delayed));
+            }
+            else
+            {
+                auto expected = 0.0;
+                for (size_t j = 0; j <= n && j < size_t (impulse.getNumSamples()); ++j)
+                    expected += double (impulse.getSample (0, int (j))) * double (input [n - j]);
+
+                filterDeviation = jmax (filterDeviation, std::abs (double (output [n]) - expected));
+            }
+        }
+
+        expectLessThan (filterDeviation, 2.4e-7, "filtering, and after resuming");
+        expectLessThan (dryDeviation, 1.0e-6, "the delayed input while bypassed");
+    }
+
+    void checkSpectral()
+    {
+        const auto gain = 0.5;
+        std::vector<double> magnitudes (SpectralEqualizer::numBins, gain);
+
+        SpectralEqualizer equalizer;
+        equalizer.prepare (2);
+        equalizer.setGains (SpectralEqualizer::makeGains (magnitudes.data()));
+
+        const size_t total = 40000, bypassStart = 15000, bypassEnd = 20000;
+        const auto input = makeInput (total);
+        std::vector<bool> bypassed;
+        const auto output  = run (equalizer, input, 2, bypassStart, bypassEnd, bypassed);
+        const auto latency = size_t (equalizer.getLatencySamples());
+
+        // the frames restart at the next hop after the longest block, and overlap again a frame later
+        const auto resumed = bypassEnd + getBlockSize (5) + SpectralEqualizer::hopSize + SpectralEqualizer::frameSize;
+
+        auto filterDeviation = 0.0, dryDeviation = 0.0, overshoot = 0.0;
+        for (auto n = latency; n < total; ++n)
+        {
+            const auto dry = double (input [n - latency]);
+            const auto wet = gain * dry;
+
+            if (bypassed [n])
+                dryDeviation = jmax (dryDeviation, std::abs (double (output [n]) - dry));
+            else if (n < bypassStart || n >= resumed)
+                filterDeviation = jmax (filterDeviation, std::abs (double (output [n]) - wet));
+            else
+                overshoot = jmax (overshoot, std::abs (double (output [n]) - 0.5 * (dry + wet)) - 0.5 * std::abs (dry - wet));
+        }
+
+        expectLessThan (filterDeviation, 1.0e-6, "filtering");
+        expectLessThan (dryDeviation, 1.0e-6, "the delayed input while bypassed");
+        expectLessThan (overshoot, 1.0e-6, "between the dry and filtered signal while resuming");
+    }
+};
+
+static EngineTest engineTest;
@@ -0,0 +1,298 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer filter cascade test
+
+  ==============================================================================
+*/
+
+#include "../../Source/FilterCascade.h"
+
+//==============================================================================
+/**
+    Runs the cascade the way the processor drives it, and compares the output with
+    a cascade that ran through without the change under test.
+*/
+class FilterCascadeTest : public UnitTest
+{
+public:
+    FilterCascadeTest() : UnitTest ("Filter cascade", "Frequalizer") {}
+
+    void runTest() override
+    {
+        // low and resonant bands at a high rate ring long, starting from rest would click
+        beginTest ("state handover between topologies");
+        {
+            expectLessThan (getHandoverDeviation<BiquadCascade, SvfCascade> (false), 1.0e-7, "biquad to state variable");
+            expectLessThan (getHandoverDeviation<SvfCascade, BiquadCascade> (false), 1.0e-7, "state variable to biquad");
+        }
+
+        beginTest ("state handover with first order and routed sections");
+        {
+            expectLessThan (getHandoverDeviation<BiquadCascade, SvfCascade> (true), 1.0e-7, "biquad to state variable");
+            expectLessThan (getHandoverDeviation<SvfCascade, BiquadCascade> (true), 1.0e-7, "state variable to biquad");
+        }
+
+        // the last filtering section carries the output gain, toggling a band hands it on
+        beginTest ("output gain while toggling a section");
+        {
+            for (auto gain : { 0.5, 1.0, 2.0 })
+            {
+                expectLessThan (getGainDeviation<BiquadCascade> (gain), 0.003, "biquad with a gain of " + String (gain));
+                expectLessThan (getGainDeviation<SvfCascade> (gain),    0.003, "state variable with a gain of " + String (gain));
+            }
+
+            expectLessThan (getMutedPeak<BiquadCascade>(), Decibels::decibelsToGain (-110.0, -200.0), "biquad muted");
+            expectLessThan (getMutedPeak<SvfCascade>(),    Decibels::decibelsToGain (-110.0, -200.0), "state variable muted");
+        }
+
+        // a control step that spans two host blocks ramps over both of them
+        beginTest ("control steps across random host blocks");
+        {
+            const auto biquad = [] (double frequency) { return FilterDesign::makePeakFilter<double> (gainRate, frequency, 2.0, 3.0); };
+            const auto svf    = [] (double frequency) { return FilterDesign::makeSvfPeakFilter<double> (gainRate, frequency, 2.0, 3.0); };
+
+            expectLessThan (getControlDeviation<FilterTopology::TransposedDirectForm2> (biquad), 1.0e-12, "biquad");
+            expectLessThan (getControlDeviation<FilterTopology::StateVariable> (svf), 1.0e-12, "state variable");
+        }
+    }
+
+private:
+    using BiquadCascade = FilterCascade<double, float, FilterTopology::TransposedDirectForm2>;
+    using SvfCascade    = FilterCascade<double, float, FilterTopology::StateVariable>;
+
+    static constexpr double handoverRate = 192000.0;
+
+    static void setSection (BiquadCascade& cascade, size_t section, const FilterDesign::Biquad<double>& c)
+    {
+        cascade.setCoefficients (section, c);
+    }
+
+    static void setSection (SvfCascade& cascade, size_t section, const FilterDesign::Biquad<double>& c)
+    {
+        cascade.setCoefficients (section, FilterDesign::toSvf<double> (c));
+    }
+
+    template<typename Cascade>
+    static void prepareHandover (Cascade& cascade, bool routed)
+    {
+        cascade.setNumSections (5);
+        cascade.prepare ({ handoverRate, 512, 2 });
+
+        setSection (cascade, 0, FilterDesign::makeHighPass<double>   (handoverRate, 20.0, 0.71));
+        setSection (cascade, 1, FilterDesign::makePeakFilter<double> (handoverRate, 100.0, 2.0, 4.0));
+        setSection (cascade, 2, FilterDesign::makeLowShelf<double>   (handoverRate, 300.0, 0.71, 0.5));
+
+        if (routed)
+        {
+            setSection (cascade, 3, FilterDesign::makeFirstOrderLowPass<double> (handoverRate, 5000.0));
+            setSection (cascade, 4, FilterDesign::makePeakFilter<double> (handoverRate, 1000.0, 1.0, 1.0001));
+            cascade.setRouting (1, ChannelRouting::Side);
+            cascade.setRouting (2, ChannelRouting::Left);
+        }
+
+        cascade.setGainLinear (0.8);
+        cascade.reset();
+    }
+
+    template<typename Cascade>
+    static void process (Cascade& cascade, std::vector<float>& left, std::vector<float>& right, size_t start, size_t num)
+    {
+        float* channels[] = { left.data() + start, right.data() + start };
+        dsp::AudioBlock<float> block (channels, 2, num);
+        cascade.process (dsp::ProcessContextReplacing<float> (block));
+    }
+
+    /** Switches from one cascade to the other halfway, and returns how far the output
+        deviates from the first cascade running through. */
+    template<typename From, typename To>
+    static double getHandoverDeviation (bool routed)
+    {
+        From from, reference;
+        To to;
+        prepareHandover (from, routed);
+        prepareHandover (reference, routed);
+        prepareHandover (to, routed);
+
+        const size_t total = 40000, handover = 20000;
+        std::vector<float> left (total), right (total);
+        for (size_t n = 0; n < total; ++n)
+        {
+            left [n]  = float (std::sin (MathConstants<double>::twoPi * 80.0 * double (n) / handoverRate));
+            right [n] = float (0.5 * std::sin (MathConstants<double>::twoPi * 37.0 * double (n) / handoverRate));
+        }
+
+        auto referenceLeft = left, referenceRight = right;
+        process (reference, referenceLeft, referenceRight, 0, total);
+
+        process (from, left, right, 0, handover);
+        to.copyStateFrom (from);
+        process (to, left, right, handover, total - handover);
+
+        auto deviation = 0.0;
+        for (size_t n = handover; n < total; ++n)
+            deviation = jmax (deviation, double (std::abs (left [n] - referenceLeft [n])), double (std::abs (right [n] - referenceRight [n])));
+
+        return deviation;
+    }
+
+    static constexpr double gainRate      = 48000.0;
+    static constexpr size_t gainBlockSize = 32;
+
+    /** Two shelves that are close to unity at the frequency of the test sine. */
+    template<typename Cascade>
+    static void prepareGain (Cascade& cascade, double gain)
+    {
+        cascade.setNumSections (2);
+        cascade.prepare ({ gainRate, uint32 (gainBlockSize), 2 });
+
+        const auto shelf = FilterDesign::makeHighShelf<double> (gainRate, 12000.0, 0.7, 1.2);
+        setSection (cascade, 0, shelf);
+        setSection (cascade, 1, shelf);
+        cascade.setGainLinear (gain);
+    }
+
+    /** Toggles the second section off, on, and quickly off and on again, while a 50 Hz
+        sine runs through. Returns the output of the blocks in between. */
+    template<typename Cascade>
+    static std::vector<float> toggleSection (Cascade& cascade)
+    {
+        std::vector<float> output;
+        size_t position = 0;
+
+        const auto run = [&] (size_t numBlocks)
+        {
+            for (size_t b = 0; b < numBlocks; ++b)
+            {
+                std::vector<float> left (gainBlockSize), right (gainBlockSize);
+                for (size_t n = 0; n < gainBlockSize; ++n)
+                    left [n] = right [n] = float (std::sin (MathConstants<double>::twoPi * 50.0 * double (position + n) / gainRate));
+
+                process (cascade, left, right, 0, gainBlockSize);
+                output.insert (output.end(), left.begin(), left.end());
+                position += gainBlockSize;
+            }
+        };
+
+        run (200);
+        cascade.setBypassed (1, true);  run (40);
+        cascade.setBypassed (1, false); run (40);
+        cascade.setBypassed (1, true);  run (2);
+        cascade.setBypassed (1, false); run (1);
+        cascade.setBypassed (1, true);  run (40);
+
+        return output;
+    }
+
+    /** The largest deviation from a cascade at unity gain doing the same, times the gain,
+        relative to the gain. */
+    template<typename Cascade>
+    static double getGainDeviation (double gain)
+    {
+        Cascade cascade, reference;
+        prepareGain (cascade, gain);
+        prepareGain (reference, 1.0);
+
+        const auto output = toggleSection (cascade);
+        const auto expected = toggleSection (reference);
+
+        auto deviation = 0.0;
+        for (size_t n = 0; n < output.size(); ++n)
+            deviation = jmax (deviation, std::abs (double (output [n]) - gain * double (expected [n])));
+
+        return deviation / gain;
+    }
+
+    template<typename Cascade>
+    static double getMutedPeak()
+    {
+        Cascade cascade;
+        prepareGain (cascade, 0.0);
+
+        auto peak = 0.0;
+        for (auto sample : toggleSection (cascade))
+            peak = jmax (peak, std::abs (double (sample)));
+
+        return peak;
+    }
+
+    static constexpr size_t controlInterval = 32;
+
+    /** Sweeps two sections and the gain at each control step. */
+    template<typename Cascade, typename Design>
+    static void setControlStep (Cascade& cascade, const Design& design, size_t step)
+    {
+        const auto frequency = 200.0 * std::pow (2.0, 5.0 * double (step) / 1500.0);
+        cascade.setTargetCoefficients (0, design (frequency));
+        cascade.setTargetCoefficients (1, design (3.0 * frequency));
+        cascade.setTargetGainLinear (1.0 + 0.5 * std::sin (double (step) * 0.01));
+    }
+
+    template<typename Cascade>
+    static void processRamp (Cascade& cascade, double* samples, size_t num, size_t numRampSamples)
+    {
+        std::vector<double> right (samples, samples + num);
+        double* channels[] = { samples, right.data() };
+        dsp::AudioBlock<double> block (channels, 2, num);
+        cascade.process (dsp::ProcessContextReplacing<double> (block), numRampSamples);
+    }
+
+    /** Runs the control steps once with blocks of the control interval, and once split
+        across random host blocks the way the processor does. Returns the largest
+        difference between the two. */
+    template<typename Topology, typename Design>
+    static double getControlDeviation (const Design& design)
+    {
+        FilterCascade<double, double, Topology> aligned, split;
+        for (auto* cascade : { &aligned, &split })
+        {
+            cascade->setNumSections (2);
+            cascade->prepare ({ gainRate, 512, 2 });
+            cascade->setCoefficients (0, design (200.0));
+            cascade->setGainLinear (1.0);
+        }
+
+        const size_t total = 48000;
+        std::vector<double> input (total);
+        for (size_t n = 0; n < total; ++n)
+            input [n] = std::sin (0.05 * double (n)) + 0.3 * std::sin (0.31 * double (n));
+
+        auto alignedOutput = input;
+        for (size_t step = 0; step * controlInterval < total; ++step)
+        {
+            setControlStep (aligned, design, step);
+            processRamp (aligned, alignedOutput.data() + step * controlInterval, controlInterval, controlInterval);
+        }
+
+        auto splitOutput = input;
+        Random random (3);
+        size_t untilControl = 0, step = 0;
+        for (size_t start = 0; start < total;)
+        {
+            const auto hostBlock = jmin (total - start, size_t (1 + random.nextInt (70)));
+            for (size_t position = 0; position < hostBlock;)
+            {
+                if (untilControl == 0)
+                {
+                    setControlStep (split, design, step++);
+                    untilControl = controlInterval;
+                }
+
+                const auto num = jmin (untilControl, hostBlock - position);
+                processRamp (split, splitOutput.data() + start + position, num, untilControl);
+                untilControl -= num;
+                position     += num;
+            }
+
+            start += hostBlock;
+        }
+
+        auto deviation = 0.0;
+        for (size_t n = 0; n < total; ++n)
+            deviation = jmax (deviation, std::abs (alignedOutput [n] - splitOutput [n]));
+
+        return deviation;
+    }
+};
+
+static FilterCascadeTest filterCascadeTest;
@@ -0,0 +1,173 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer filter design test
+
+  ==============================================================================
+*/
+
+#include "../../Source/FilterDesign.h"
+#include "TestUtilities.h"
+
+namespace FilterDesign
+{
+
+//==============================================================================
+/**
+    Checks the fast math against the standard library, and the designs using it
+    against the designs of dsp::IIR::Coefficients, which use std::tan, std::sin
+    and std::cos. Both the coefficients and the magnitude responses are compared
+    across sample rates, frequencies, qualities and gains.
+*/
+class AccuracyTest : public UnitTest
+{
+public:
+    AccuracyTest() : UnitTest ("Filter design accuracy", "Frequalizer") {}
+
+    void runTest() override
+    {
+        beginTest ("sinCos and tan");
+        {
+            double maxError = 0, maxTanError = 0;
+            for (int i = -1000; i <= 1000; ++i)
+            {
+                const auto x = MathConstants<double>::pi * i / 1000.0;
+                double s, c;
+                FastMath::sinCos (x, s, c);
+                maxError = jmax (maxError, std::abs (s - std::sin (x)), std::abs (c - std::cos (x)));
+
+                const auto t = 0.4999 * x;
+                if (t != 0.0)
+                    maxTanError = jmax (maxTanError, std::abs (FastMath::tan (t) / std::tan (t) - 1.0));
+            }
+            expectLessThan (maxError, 1.0e-13);
+            expectLessThan (maxTanError, 1.0e-11);
+        }
+
+        beginTest ("exp2");
+        {
+            double maxError = 0;
+            for (int i = -10000; i <= 10000; ++i)
+            {
+                const auto x = i / 10.0;
+                maxError = jmax (maxError, std::abs (FastMath::exp2 (x) / std::exp2 (x) - 1.0));
+            }
+            expectLessThan (maxError, 1.0e-13);
+        }
+
+        using Exact = dsp::IIR::Coefficients<double>;
+
+        beginTest ("designs against the exact designs");
+        {
+            Errors errors;
+            for (auto sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+            {
+                // 20 Hz up to 20 kHz in thirds of an octave, the processor keeps them below 0.49 * sampleRate
+                for (int step = 0; step <= 30; ++step)
+                {
+                    const auto frequency = jmin (20.0 * std::pow (2.0, step / 3.0), 0.49 * sampleRate);
+                    errors.setting = String (frequency) + " Hz at " + String (sampleRate) + " Hz";
+
+                    compare ("first order low pass",  makeFirstOrderLowPass<double>  (sampleRate, frequency), *Exact::makeFirstOrderLowPass  (sampleRate, frequency), sampleRate, errors);
+                    compare ("first order high pass", makeFirstOrderHighPass<double> (sampleRate, frequency), *Exact::makeFirstOrderHighPass (sampleRate, frequency), sampleRate, errors);
+                    compare ("first order all pass",  makeFirstOrderAllPass<double>  (sampleRate, frequency), *Exact::makeFirstOrderAllPass  (sampleRate, frequency), sampleRate, errors);
+
+                    for (auto quality : { 0.1, 0.71, 2.0, 10.0 })
+                    {
+                        compare ("low pass",  makeLowPass<double>  (sampleRate, frequency, quality), *Exact::makeLowPass  (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("high pass", makeHighPass<double> (sampleRate, frequency, quality), *Exact::makeHighPass (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("band pass", makeBandPass<double> (sampleRate, frequency, quality), *Exact::makeBandPass (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("notch",     makeNotch<double>    (sampleRate, frequency, quality), *Exact::makeNotch    (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("all pass",  makeAllPass<double>  (sampleRate, frequency, quality), *Exact::makeAllPass  (sampleRate, frequency, quality), sampleRate, errors);
+
+                        for (auto gain : { 0.125, 0.5, 2.0, 8.0 })
+                        {
+                            compare ("peak",       makePeakFilter<double> (sampleRate, frequency, quality, gain), *Exact::makePeakFilter (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("low shelf",  makeLowShelf<double>   (sampleRate, frequency, quality, gain), *Exact::makeLowShelf   (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("high shelf", makeHighShelf<double>  (sampleRate, frequency, quality, gain), *Exact::makeHighShelf  (sampleRate, frequency, quality, gain), sampleRate, errors);
+                        }
+                    }
+                }
+            }
+
+            expectLessThan (errors.coefficients.value, 1.0e-12, "coefficients of the " + errors.coefficients.design);
+            expectLessThan (errors.magnitudes.value,   1.0e-6,  "magnitudes of the " + errors.magnitudes.design);
+        }
+
+        beginTest ("state variable designs against the exact designs");
+        {
+            // the state variable sections are compared as the biquads with the same response
+            Errors errors;
+            for (auto sampleRate : { 44100.0, 48000.0, 96000.0, 192000.0 })
+            {
+                for (int step = 0; step <= 30; ++step)
+                {
+                    const auto frequency = jmin (20.0 * std::pow (2.0, step / 3.0), 0.49 * sampleRate);
+                    errors.setting = String (frequency) + " Hz at " + String (sampleRate) + " Hz";
+
+                    compare ("first order low pass",  toBiquad (makeSvfFirstOrderLowPass<double>  (sampleRate, frequency)), *Exact::makeFirstOrderLowPass  (sampleRate, frequency), sampleRate, errors);
+                    compare ("first order high pass", toBiquad (makeSvfFirstOrderHighPass<double> (sampleRate, frequency)), *Exact::makeFirstOrderHighPass (sampleRate, frequency), sampleRate, errors);
+                    compare ("first order all pass",  toBiquad (makeSvfFirstOrderAllPass<double>  (sampleRate, frequency)), *Exact::makeFirstOrderAllPass  (sampleRate, frequency), sampleRate, errors);
+
+                    for (auto quality : { 0.1, 0.71, 2.0, 10.0 })
+                    {
+                        compare ("low pass",  toBiquad (makeSvfLowPass<double>  (sampleRate, frequency, quality)), *Exact::makeLowPass  (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("high pass", toBiquad (makeSvfHighPass<double> (sampleRate, frequency, quality)), *Exact::makeHighPass (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("band pass", toBiquad (makeSvfBandPass<double> (sampleRate, frequency, quality)), *Exact::makeBandPass (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("notch",     toBiquad (makeSvfNotch<double>    (sampleRate, frequency, quality)), *Exact::makeNotch    (sampleRate, frequency, quality), sampleRate, errors);
+                        compare ("all pass",  toBiquad (makeSvfAllPass<double>  (sampleRate, frequency, quality)), *Exact::makeAllPass  (sampleRate, frequency, quality), sampleRate, errors);
+
+                        for (auto gain : { 0.125, 0.5, 2.0, 8.0 })
+                        {
+                            compare ("peak",       toBiquad (makeSvfPeakFilter<double> (sampleRate, frequency, quality, gain)), *Exact::makePeakFilter (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("low shelf",  toBiquad (makeSvfLowShelf<double>   (sampleRate, frequency, quality, gain)), *Exact::makeLowShelf   (sampleRate, frequency, quality, gain), sampleRate, errors);
+                            compare ("high shelf", toBiquad (makeSvfHighShelf<double>  (sampleRate, frequency, quality, gain)), *Exact::makeHighShelf  (sampleRate, frequency, quality, gain), sampleRate, errors);
+                        }
+                    }
+                }
+            }
+
+            expectLessThan (errors.coefficients.value, 1.0e-12, "coefficients of the " + errors.coefficients.design);
+            expectLessThan (errors.magnitudes.value,   1.0e-6,  "magnitudes of the " + errors.magnitudes.design);
+        }
+    }
+
+private:
+    /** The largest errors so far, and the setting of the designs being compared. */
+    struct Errors
+    {
+        WorstCase coefficients, magnitudes;
+        String    setting;
+    };
+
+    static void compare (const String& name, const Biquad<double>& c, const dsp::IIR::Coefficients<double>& exact,
+                         double sampleRate, Errors& errors)
+    {
+        // the exact first order designs only have b0, b1 and a1
+        const auto* raw = exact.getRawCoefficients();
+        const auto reference = exact.getFilterOrder() == 1 ? Biquad<double> { raw [0], raw [1], 0.0, raw [2], 0.0 }
+                                                           : Biquad<double> { raw [0], raw [1], raw [2], raw [3], raw [4] };
+
+        const double values [] = { c.b0, c.b1, c.b2, c.a1, c.a2 };
+        const double expected [] = { reference.b0, reference.b1, reference.b2, reference.a1, reference.a2 };
+        for (size_t k = 0; k < 5; ++k)
+        {
+            const auto error = std::abs (values [k] - expected [k]) / jmax (1.0, std::abs (expected [k]));
+            errors.coefficients.add (error, name + " with " + errors.setting);
+        }
+
+        // the magnitudes relative to the exact ones, and to -40 dB below that, where a notch goes to zero
+        for (int step = 0; step <= 60; ++step)
+        {
+            const auto frequency = jmin (20.0 * std::pow (2.0, step / 6.0), 0.5 * sampleRate);
+            const auto magnitude = getMagnitudeForFrequency (c, frequency, sampleRate);
+            const auto exactMagnitude = exact.getMagnitudeForFrequency (frequency, sampleRate);
+            const auto error = std::abs (magnitude - exactMagnitude) / jmax (exactMagnitude, 1.0e-2);
+            errors.magnitudes.add (error, name + " with " + errors.setting + ", at " + String (frequency) + " Hz");
+        }
+    }
+};
+
+static AccuracyTest accuracyTest;
+
+} // namespace FilterDesign
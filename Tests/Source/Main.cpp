@@ -0,0 +1,29 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer test runner
+
+  ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+//==============================================================================
+/** Runs the tests of the Frequalizer category, the exit code is 1 if any failed. */
+int main (int argc, char* argv[])
+{
+    ignoreUnused (argc, argv);
+
+    // the processor's parameters and updates need the message manager
+    ScopedJuceInitialiser_GUI juce;
+
+    UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runTestsInCategory ("Frequalizer");
+
+    int numFailures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult (i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    This is the Frequalizer channel routing test
+
+  ==============================================================================
+*/
+
+#include "../../Source/FrequalizerProcessor.h"
+
+//==============================================================================
+/**
+    Routes a band to some of the channels, and compares the output with the same
+    band on stereo and with the band switched off. Every engine must filter only
+    the channels the band is routed to.
+*/
+class RoutingTest : public UnitTest
+{
+public:
+    RoutingTest() : UnitTest ("Channel routing", "Frequalizer") {}
+
+    void runTest() override
+    {
+        // the engine is the normalised parameter value
+        const std::pair<String, float> engines[] = { { "minimum phase", 0.0f }, { "linear phase", 0.5f }, { "spectral", 1.0f } };
+
+        for (const auto& engine : engines)
+        {
+            beginTest (engine.first + ", left and right");
+            {
+                Random random (42);
+                const auto input = makeNoise (random, false);
+                const auto left  = process (input, engine.second, ChannelRouting::Left);
+                const auto right = process (input, engine.second, ChannelRouting::Right);
+                const auto both  = process (input, engine.second, ChannelRouting::Stereo);
+                const auto none  = process (input, engine.second, Inactive);
+
+                expectLessThan (getDeviation (left,  both, 0), tolerance, "the left band filters the left channel");
+                expectLessThan (getDeviation (left,  none, 1), tolerance, "the left band leaves the right channel");
+                expectLessThan (getDeviation (right, none, 0), tolerance, "the right band leaves the left channel");
+                expectLessThan (getDeviation (right, both, 1), tolerance, "the right band filters the right channel");
+                expectGreaterThan (getDeviation (both, none, 0), 100.0 * tolerance, "the band makes a difference");
+            }
+
+            // with the same signal on both channels there is only mid
+            beginTest (engine.first + ", mid and side");
+            {
+                Random random (42);
+                const auto input = makeNoise (random, true);
+                const auto mid   = process (input, engine.second, ChannelRouting::Mid);
+                const auto side  = process (input, engine.second, ChannelRouting::Side);
+                const auto both  = process (input, engine.second, ChannelRouting::Stereo);
+                const auto none  = process (input, engine.second, Inactive);
+
+                for (int ch = 0; ch < 2; ++ch)
+                {
+                    expectLessThan (getDeviation (mid,  both, ch), tolerance, "the mid band filters the mono signal");
+                    expectLessThan (getDeviation (side, none, ch), tolerance, "the side band leaves the mono signal");
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int    blockSize  = 512;
+    static constexpr int    numSamples = 48000;
+    static constexpr double tolerance  = 1.0e-4;
+
+    // the band is a peak, and switched off for a routing past the last one
+    static constexpr size_t band = 2;
+    static constexpr auto   Inactive = ChannelRouting (int (ChannelRouting::Side) + 1);
+
+    static AudioBuffer<float> makeNoise (Random& random, bool mono)
+    {
+        AudioBuffer<float> buffer (2, numSamples);
+        for (int n = 0; n < numSamples; ++n)
+        {
+            const auto left = random.nextFloat() * 0.5f - 0.25f;
+            buffer.setSample (0, n, left);
+            buffer.setSample (1, n, mono ? left : random.nextFloat() * 0.5f - 0.25f);
+        }
+
+        return buffer;
+    }
+
+    static void setParameter (FrequalizerAudioProcessor& processor, const String& parameterID, float value)
+    {
+        auto* parameter = processor.getPluginState().getParameter (parameterID);
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+    }
+
+    /** Filters the input with a stereo processor, whose band is set up before it is
+        prepared, so it filters from the first sample on. */
+    static AudioBuffer<float> process (const AudioBuffer<float>& input, float engine, ChannelRouting routing)
+    {
+        FrequalizerAudioProcessor processor;
+        processor.getPluginState().getParameter (FrequalizerAudioProcessor::paramEngine)->setValueNotifyingHost (engine);
+        setParameter (processor, FrequalizerAudioProcessor::getGainParamName (band), 4.0f);
+        setParameter (processor, FrequalizerAudioProcessor::getActiveParamName (band), routing == Inactive ? 0.0f : 1.0f);
+        setParameter (processor, FrequalizerAudioProcessor::getRoutingParamName (band), routing == Inactive ? 0.0f : float (routing));
+
+        processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+        processor.prepareToPlay (sampleRate, blockSize);
+
+        auto output = input;
+        MidiBuffer midi;
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            AudioBuffer<float> block (output.getArrayOfWritePointers(), 2, start, jmin (blockSize, numSamples - start));
+            processor.processBlock (block, midi);
+        }
+
+        return output;
+    }
+
+    static double getDeviation (const AudioBuffer<float>& a, const AudioBuffer<float>& b, int channel)
+    {
+        auto deviation = 0.0;
+        for (int n = 0; n < numSamples; ++n)
+            deviation = jmax (deviation, std::abs (double (a.getSample (channel, n)) - double (b.getSample (channel, n))));
+
+        return deviation;
+    }
+};
+
+static RoutingTest routingTest;
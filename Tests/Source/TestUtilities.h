@@ -0,0 +1,38 @@
+/*
+  ==============================================================================
+
+    These are the Frequalizer test utilities
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The worst value of an error measure so far, and the design it came from. The
+    largest value is the worst, unless the measure is a lower bound.
+*/
+struct WorstCase
+{
+    explicit WorstCase (bool isLowerBoundToUse = false)
+      : isLowerBound (isLowerBoundToUse), value (isLowerBoundToUse ? std::numeric_limits<double>::max() : 0.0)
+    {
+    }
+
+    /** Keeps the value and its design if it is worse than the worst so far. */
+    void add (double newValue, const String& newDesign)
+    {
+        if (isLowerBound ? newValue < value : newValue > value)
+        {
+            value  = newValue;
+            design = newDesign;
+        }
+    }
+
+    bool   isLowerBound;
+    double value;
+    String design;
+};